@@ -23,6 +23,25 @@ void LookAndFeel::drawRotarySlider(juce::Graphics & g,
         auto bounds = juce::Rectangle<float> (x, y, width, height).reduced (2.0f);
         auto radius = juce::jmin (bounds.getWidth(), bounds.getHeight()) / 2.0f;
         auto toAngle = rotaryStartAngle + sliderPos * (rotaryEndAngle - rotaryStartAngle);
+
+        g.setColour (juce::Colour::fromRGB(105, 105, 105));
+        g.fillPath (createRotaryBackground (bounds, rotaryStartAngle, rotaryEndAngle));
+
+        juce::Path valueArc, stick;
+        createRotaryValue (bounds, rotaryStartAngle, toAngle, valueArc, stick);
+
+        g.setColour (fill);
+        g.fillPath (valueArc);
+
+    g.setColour (juce::Colour::fromRGB(211, 211, 211));
+        g.fillPath (stick);
+
+        g.fillEllipse (bounds.reduced (radius * 0.25));
+}
+
+juce::Path LookAndFeel::createRotaryBackground(juce::Rectangle<float> bounds, float rotaryStartAngle, float rotaryEndAngle)
+{
+        auto radius = juce::jmin (bounds.getWidth(), bounds.getHeight()) / 2.0f;
         auto lineW = radius * 0.085f;
         auto arcRadius = radius - lineW * 1.6f;
 
@@ -36,54 +55,36 @@ void LookAndFeel::drawRotarySlider(juce::Graphics & g,
                                      rotaryEndAngle,
                                      true);
 
-        g.setColour (juce::Colour::fromRGB(105, 105, 105));
-        g.strokePath (backgroundArc, juce::PathStrokeType (lineW, juce::PathStrokeType::curved, juce::PathStrokeType::rounded));
-
-        juce::Path valueArc;
-        valueArc.addCentredArc (bounds.getCentreX(),
-                                bounds.getCentreY(),
-                                arcRadius,
-                                arcRadius,
-                                0.0f,
-                                rotaryStartAngle,
-                                toAngle,
-                                true);
+        juce::Path stroked;
+        juce::PathStrokeType (lineW, juce::PathStrokeType::curved, juce::PathStrokeType::rounded).createStrokedPath (stroked, backgroundArc);
+        return stroked;
+}
 
-        g.setColour (fill);
-        g.strokePath (valueArc, juce::PathStrokeType (lineW, juce::PathStrokeType::curved, juce::PathStrokeType::rounded));
+void LookAndFeel::createRotaryValue(juce::Rectangle<float> bounds, float rotaryStartAngle, float toAngle,
+                                    juce::Path& valueArc, juce::Path& stick)
+{
+        auto radius = juce::jmin (bounds.getWidth(), bounds.getHeight()) / 2.0f;
+        auto lineW = radius * 0.085f;
+        auto arcRadius = radius - lineW * 1.6f;
 
-        juce::Path stick;
-        auto stickWidth = lineW * 2.0f;
+        juce::Path arc;
+        arc.addCentredArc (bounds.getCentreX(),
+                           bounds.getCentreY(),
+                           arcRadius,
+                           arcRadius,
+                           0.0f,
+                           rotaryStartAngle,
+                           toAngle,
+                           true);
 
-        stick.addRectangle (-stickWidth / 2, -stickWidth / 2, stickWidth, radius + lineW);
+        valueArc.clear();
+        juce::PathStrokeType (lineW, juce::PathStrokeType::curved, juce::PathStrokeType::rounded).createStrokedPath (valueArc, arc);
 
-    g.setColour (juce::Colour::fromRGB(211, 211, 211));
-        g.fillPath (stick, juce::AffineTransform::rotation (toAngle + 3.12f).translated (bounds.getCentre()));
+        auto stickWidth = lineW * 2.0f;
 
-        g.fillEllipse (bounds.reduced (radius * 0.25));
-    
-    if(auto *rswl = dynamic_cast<RotarySliderWithLabels*>(&slider)){
-        auto center = bounds.getCentre();
-        juce::Path p;
-        juce::Rectangle<float> r;
-        r.setLeft(center.getX()-2);
-        r.setRight(center.getX()+2);
-        r.setTop(bounds.getY());
-        r.setBottom(center.getY()-rswl->getTextHeight()*1.5);
-        p.addRoundedRectangle(r, 2.f);
-        jassert(rotaryStartAngle < rotaryEndAngle);
-        auto sliderAngRad = juce::jmap(sliderPos, 0.f, 1.f, rotaryStartAngle, rotaryEndAngle);
-        p.applyTransform(juce::AffineTransform().rotated(sliderAngRad,center.getX(), center.getY()));
-        g.fillPath(p);
-        g.setFont(10);
-        auto text = rswl->getDisplayString();
-        r.setSize(40, rswl->getTextHeight());
-        r.setCentre(bounds.getCentre());
-        g.setColour (juce::Colour::fromRGB(211, 211, 211));
-        g.fillRect(r);
-        g.setColour(juce::Colour::fromRGB(34, 34, 34));
-        g.drawFittedText(text, r.toNearestInt(), juce::Justification::centred, 1);
-    }
+        stick.clear();
+        stick.addRectangle (-stickWidth / 2, -stickWidth / 2, stickWidth, radius + lineW);
+        stick.applyTransform (juce::AffineTransform::rotation (toAngle + 3.12f).translated (bounds.getCentre()));
 }
 
 void LookAndFeel::drawToggleButton(juce::Graphics &g,
@@ -124,52 +125,111 @@ void LookAndFeel::drawToggleButton(juce::Graphics &g,
     g.strokePath(powerButton, pst);
     g.drawEllipse(r, 2);
  }
+
+// where the knobs' travel starts and ends, clockwise from 12 o'clock
+static constexpr float RotaryStartAngle = juce::degreesToRadians(180.f + 45.f);
+static constexpr float RotaryEndAngle = juce::degreesToRadians(180.f - 45.f) + juce::MathConstants<float>::twoPi;
+
 void RotarySliderWithLabels::paint(juce::Graphics &g)
  {
      using namespace juce;
 
-     auto startAng = degreesToRadians(180.f + 45.f);
-     auto endAng = degreesToRadians(180.f - 45.f) + MathConstants<float>::twoPi;
+     if( staticShapesAreStale )
+         updateStaticShapes();
+     if( valueShapesAreStale )
+         updateValueShapes();
 
-     auto range = getRange();
+     g.setColour(Colour::fromRGB(105, 105, 105));
+     g.fillPath(backgroundArc);
+
+     g.setColour(findColour(Slider::rotarySliderFillColourId));
+     g.fillPath(valueArc);
+
+     g.setColour(Colour::fromRGB(211, 211, 211));
+     g.fillPath(stick);
+     g.fillEllipse(knob);
+     g.fillPath(pointer);
+     g.fillRect(textBox);
+
+     g.setColour(Colour::fromRGB(34, 34, 34));
+     valueText.draw(g);
+
+     g.setColour(Colour::fromRGB(0,0,0));
+     rangeLabels.draw(g);
+ }
+
+void RotarySliderWithLabels::resized()
+{
+    Slider::resized();
+    staticShapesAreStale = true;
+    valueShapesAreStale = true;
+}
+
+void RotarySliderWithLabels::valueChanged()
+{
+    valueShapesAreStale = true;
+}
+
+void RotarySliderWithLabels::updateStaticShapes()
+{
+    using namespace juce;
+    staticShapesAreStale = false;
+
+    auto sliderBounds = getSliderBounds();
+    backgroundArc = LookAndFeel::createRotaryBackground(sliderBounds.toFloat().reduced(2.0f), RotaryStartAngle, RotaryEndAngle);
 
-     auto sliderBounds = getSliderBounds();
-    
-//     g.setColour(Colours::red);
-//     g.drawRect(getLocalBounds());
-//     g.drawRect(sliderBounds);
-
-     getLookAndFeel().drawRotarySlider(g,
-                                       sliderBounds.getX(),
-                                       sliderBounds.getY(),
-                                       sliderBounds.getWidth(),
-                                       sliderBounds.getHeight(),
-                                       jmap(getValue(), range.getStart(), range.getEnd(), 0.0, 1.0),
-                                       startAng,
-                                       endAng,
-                                       *this);
-    
     auto center = sliderBounds.toFloat().getCentre();
     auto radius = sliderBounds.getWidth() * 0.5f;
-    g.setColour(juce::Colour::fromRGB(0,0,0));
-    g.setFont(10);
+    Font font(10);
+    rangeLabels.clear();
     auto numChoices = labels.size();
     for( int i = 0; i < numChoices; ++i ){
         auto pos = labels[i].pos;
         jassert(0.f <= pos);
         jassert(pos <= 1.f);
-        auto ang = jmap(pos, 0.f, 1.f, startAng, endAng);
+        auto ang = jmap(pos, 0.f, 1.f, RotaryStartAngle, RotaryEndAngle);
         auto c = center.getPointOnCircumference(radius + getTextHeight() * 0.5f + 1, ang);
         Rectangle<float> r;
         auto str = labels[i].label;
-        r.setSize(g.getCurrentFont().getStringWidth(str), getTextHeight());
+        r.setSize(font.getStringWidth(str), getTextHeight());
         r.setCentre(c);
         r.setY(r.getY() + getTextHeight());
-        g.drawFittedText(str, r.toNearestInt(), juce::Justification::centred,1);
-        
+        auto area = r.toNearestInt().toFloat();
+        rangeLabels.addFittedText(font, str, area.getX(), area.getY(), area.getWidth(), area.getHeight(), juce::Justification::centred, 1);
     }
-    
- }
+}
+
+void RotarySliderWithLabels::updateValueShapes()
+{
+    using namespace juce;
+    valueShapesAreStale = false;
+
+    auto range = getRange();
+    auto sliderPos = (float) jmap(getValue(), range.getStart(), range.getEnd(), 0.0, 1.0);
+    auto toAngle = RotaryStartAngle + sliderPos * (RotaryEndAngle - RotaryStartAngle);
+
+    auto bounds = getSliderBounds().toFloat().reduced(2.0f);
+    auto radius = jmin(bounds.getWidth(), bounds.getHeight()) / 2.0f;
+    LookAndFeel::createRotaryValue(bounds, RotaryStartAngle, toAngle, valueArc, stick);
+    knob = bounds.reduced(radius * 0.25);
+
+    auto center = bounds.getCentre();
+    Rectangle<float> r;
+    r.setLeft(center.getX()-2);
+    r.setRight(center.getX()+2);
+    r.setTop(bounds.getY());
+    r.setBottom(center.getY()-getTextHeight()*1.5);
+    pointer.clear();
+    pointer.addRoundedRectangle(r, 2.f);
+    pointer.applyTransform(AffineTransform().rotated(toAngle, center.getX(), center.getY()));
+
+    r.setSize(40, getTextHeight());
+    r.setCentre(bounds.getCentre());
+    textBox = r;
+    auto area = r.toNearestInt().toFloat();
+    valueText.clear();
+    valueText.addFittedText(Font(10), getDisplayString(), area.getX(), area.getY(), area.getWidth(), area.getHeight(), juce::Justification::centred, 1);
+}
 
  juce::Rectangle<int> RotarySliderWithLabels::getSliderBounds() const
  {
@@ -184,11 +244,11 @@ void RotarySliderWithLabels::paint(juce::Graphics &g)
  }
 
 juce::String RotarySliderWithLabels::getDisplayString() const {
-   if( auto *choiceParam = dynamic_cast<juce::AudioParameterChoice*>(param))
+   if( choiceParam != nullptr )
        return choiceParam->getCurrentChoiceName();
     juce::String str;
     bool addK = false;
-    if( auto *floatParam = dynamic_cast<juce::AudioParameterFloat*>(param)){
+    if( isFloatParam ){
         float val = getValue();
         if( val > 999.f ){
             val /= 1000.f;
@@ -211,9 +271,122 @@ void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float new
     parametersChanged.set(true);
 }
 
-ResponseCurveComponent::ResponseCurveComponent(EqualizerAudioProcessor& p) : audioProcessor(p),
-leftPathProducer(audioProcessor.leftChannelFifo),
-rightPathProducer(audioProcessor.rightChannelFifo)
+SpectrogramComponent::SpectrogramComponent()
+{
+    using namespace juce;
+    ColourGradient gradient(Colours::black, 0.f, 0.f, Colours::yellow, 1.f, 0.f, false);
+    gradient.addColour(0.35, Colours::darkblue);
+    gradient.addColour(0.6, Colours::purple);
+    gradient.addColour(0.8, Colours::orange);
+
+    for( int i = 0; i < NumColours; ++i )
+        colourLut[i] = gradient.getColourAtPosition(double(i) / double(NumColours - 1)).getPixelARGB();
+
+    setOpaque(true);
+}
+
+void SpectrogramComponent::pushFrame(const std::vector<float>& decibels, float negativeInfinity){
+    if( !ring.isValid() || decibels.empty() )
+        return;
+
+    const auto height = ring.getHeight();
+    const auto lastPoint = float(decibels.size() - 1);
+
+    {
+        juce::Image::BitmapData column(ring, writeColumn, 0, 1, height, juce::Image::BitmapData::writeOnly);
+        for( int y = 0; y < height; ++y )
+        {
+            auto point = (size_t) (rowPositions[y] * lastPoint + 0.5f);
+            auto level = juce::jmap(decibels[point], negativeInfinity, 0.f, 0.f, float(NumColours - 1));
+            auto index = juce::jlimit(0, NumColours - 1, (int) level);
+            *reinterpret_cast<juce::PixelARGB*>(column.getPixelPointer(0, y)) = colourLut[index];
+        }
+    }
+
+    writeColumn = (writeColumn + 1) % ring.getWidth();
+    repaint();
+}
+
+void SpectrogramComponent::paint(juce::Graphics& g){
+    if( !ring.isValid() )
+        return;
+
+    // oldest first: the columns from the write position to the end, then the ones before it
+    const auto width = ring.getWidth();
+    const auto height = ring.getHeight();
+    const auto olderWidth = width - writeColumn;
+
+    g.drawImage(ring, 0, 0, olderWidth, height, writeColumn, 0, olderWidth, height);
+    if( writeColumn > 0 )
+        g.drawImage(ring, olderWidth, 0, writeColumn, height, 0, 0, writeColumn, height);
+}
+
+void SpectrogramComponent::resized(){
+    using namespace juce;
+    auto width = jmax(1, getWidth());
+    auto height = jmax(1, getHeight());
+
+    // the only allocation: the ring is exactly the size it is drawn at
+    ring = Image(Image::PixelFormat::ARGB, width, height, false);
+    Graphics g(ring);
+    g.fillAll(Colours::black);
+    writeColumn = 0;
+
+    rowPositions.resize(height);
+    for( int y = 0; y < height; ++y )
+        rowPositions[y] = height > 1 ? 1.f - float(y) / float(height - 1) : 0.f;
+}
+
+MeterComponent::MeterComponent(EqualizerAudioProcessor& p) : audioProcessor(p)
+{
+    audioProcessor.metersActive.store(true);
+    startTimerHz(30);
+}
+
+MeterComponent::~MeterComponent(){
+    audioProcessor.metersActive.store(false);
+}
+
+void MeterComponent::paint(juce::Graphics& g){
+    using namespace juce;
+    g.fillAll(Colours::black);
+
+    auto bounds = getLocalBounds().reduced(2);
+    auto sectionHeight = bounds.getHeight() / 2;
+    const int fontHeight = 10;
+    g.setFont(fontHeight);
+
+    auto drawSection = [&g, fontHeight](Rectangle<int> area, const String& name, const LoudnessMeter& meter)
+    {
+        auto label = area.removeFromTop(fontHeight + 2);
+        String str;
+        str << name << "  M " << String(meter.getMomentaryLoudness(), 1) << "  S " << String(meter.getShortTermLoudness(), 1) << " LUFS";
+        g.setColour(Colours::white);
+        g.drawFittedText(str, label, Justification::centredLeft, 1);
+
+        // RMS as the bar, peak as the tick, over -60..0 dB
+        auto barHeight = area.getHeight() / 2;
+        for( int ch = 0; ch < 2; ++ch )
+        {
+            auto bar = area.removeFromTop(barHeight).reduced(0, 1).toFloat();
+            auto toX = [&bar](float db) { return jmap(jlimit(-60.f, 0.f, db), -60.f, 0.f, bar.getX(), bar.getRight()); };
+
+            g.setColour(Colours::darkgrey);
+            g.fillRect(bar);
+            g.setColour(Colours::limegreen);
+            g.fillRect(bar.withRight(toX(meter.getRms(ch))));
+            g.setColour(meter.getPeak(ch) > -0.1f ? Colours::red : Colours::white);
+            g.drawVerticalLine(roundToInt(toX(meter.getPeak(ch))), bar.getY(), bar.getBottom());
+        }
+    };
+
+    drawSection(bounds.removeFromTop(sectionHeight), "IN", audioProcessor.inputMeter);
+    drawSection(bounds, "OUT", audioProcessor.outputMeter);
+}
+
+ResponseCurveComponent::ResponseCurveComponent(EqualizerAudioProcessor& p, SpectrogramComponent& spectrogramComponent) : audioProcessor(p),
+spectrogram(spectrogramComponent),
+pathProducer(audioProcessor.analyzerCapture)
 {
     const auto& params = audioProcessor.getParameters();
     for( auto param : params )
@@ -233,59 +406,140 @@ ResponseCurveComponent::~ResponseCurveComponent(){
 }
 
 
-void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate){
-    juce::AudioBuffer<float> tempIncomingBuffer;
+// left, mid or the sum of one tap pair, as a single signal
+void PathProducer::mixDown(int leftTap, AnalyzerDisplay display, int start, int numSamples, std::vector<float>& dest) const {
+    auto* left = window.getReadPointer(leftTap, start);
+    auto* right = window.getReadPointer(leftTap + 1, start);
+    auto* out = dest.data() + start;
 
-        while( leftChannelFifo->getNumCompleteBuffersAvailable() > 0 )
-        {
-            if( leftChannelFifo->getAudioBuffer(tempIncomingBuffer) )
-            {
-                auto size = tempIncomingBuffer.getNumSamples();
+    switch( display )
+    {
+        case AnalyzerDisplay_LeftRight:
+            juce::FloatVectorOperations::copy(out, left, numSamples);
+            break;
+        case AnalyzerDisplay_MidSide:
+            juce::FloatVectorOperations::add(out, left, right, numSamples);
+            juce::FloatVectorOperations::multiply(out, 0.5f, numSamples);
+            break;
+        case AnalyzerDisplay_Sum:
+            juce::FloatVectorOperations::add(out, left, right, numSamples);
+            break;
+    }
+}
 
-                juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                                                  monoBuffer.getReadPointer(0, size),
-                                                  monoBuffer.getNumSamples() - size);
+void PathProducer::pushToGenerator(AnalyzerSource source, AnalyzerDisplay display, int start, int numSamples){
+    if( source == AnalyzerSource_Post )
+    {
+        fftDataGenerator.push(window.getReadPointer(AnalyzerCapture::PostLeft, start),
+                              window.getReadPointer(AnalyzerCapture::PostRight, start),
+                              numSamples);
+        return;
+    }
 
-                juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-                                                  tempIncomingBuffer.getReadPointer(0, 0),
-                                                  size);
+    // pre and post of the same signal go through the transform as a 'left/right' pair
+    mixDown(AnalyzerCapture::PreLeft, display, start, numSamples, preSignal);
+    mixDown(AnalyzerCapture::PostLeft, display, start, numSamples, postSignal);
+    fftDataGenerator.push(preSignal.data() + start, postSignal.data() + start, numSamples);
+}
 
-                leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
-            }
-        }
+bool PathProducer::getSpectrogramData(std::vector<float>& dest){
+    if( !spectrogramDataIsNew )
+        return false;
+
+    dest = spectrogramData;
+    spectrogramDataIsNew = false;
+    return true;
+}
+
+void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate, AnalyzerSource source, AnalyzerDisplay display){
+    // not prepared to play yet
+    if( sampleRate <= 0 )
+        return;
+
+    if( sampleRate != preparedSampleRate )
+    {
+        fftDataGenerator.prepare(FFTOrder::order2048, sampleRate);
+        preparedSampleRate = sampleRate;
+    }
+
+    // one transform per tick at most; nothing new means the current traces still hold
+    auto numNew = capture->read(window);
+    if( numNew == 0 )
+        return;
+
+    // what the generator has seen so far belongs to another signal; refill it from the window
+    if( source != feedingSource || display != feedingDisplay )
+    {
+        fftDataGenerator.reset();
+        feedingSource = source;
+        feedingDisplay = display;
+        numNew = window.getNumSamples();
+    }
 
-        /*
-         if there are FFT data buffers to pull
-            if we can pull a buffer
-                generate a path
-         */
+    auto start = window.getNumSamples() - numNew;
+    pushToGenerator(source, display, start, numNew);
 
-        const auto fftSize = leftChannelFFTDataGenerator.getFFTSize();
+    auto traceDisplay = source == AnalyzerSource_Post ? display : AnalyzerDisplay_LeftRight;
+    fftDataGenerator.produceFFTDataForRendering(traceDisplay, -48.f);
 
-        /*
-         48000 / 2048 = 23hz  <- this is the bin width
-         */
-    const auto binWidth = sampleRate / (double)fftSize;
+    const auto& frequencies = fftDataGenerator.getFrequencies();
 
-        while( leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0 )
+    std::vector<float> fftData;
+    if( source == AnalyzerSource_Difference )
+    {
+        // the measured response: post minus pre, drawn on the response curve's +/-24 dB scale
+        while( fftDataGenerator.getNumAvailableFFTDataBlocks() > 0 && fftDataGenerator.getNumAvailableSecondFFTDataBlocks() > 0 )
         {
-            std::vector<float> fftData;
-            if( leftChannelFFTDataGenerator.getFFTData(fftData) )
+            if( fftDataGenerator.getFFTData(differenceData) && fftDataGenerator.getSecondFFTData(fftData) )
             {
-                pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.f);
+                spectrogramData = fftData;
+                spectrogramDataIsNew = true;
+
+                for( size_t i = 0; i < differenceData.size(); ++i )
+                    differenceData[i] = juce::jlimit(-24.f, 24.f, fftData[i] - differenceData[i]);
+
+                firstPathGenerator.generatePath(differenceData, frequencies, fftBounds, -24.f, 24.f);
             }
         }
+    }
 
-        /*
-         while there are paths that can be pull
-            pull as many as we can
-                display the most recent path
-         */
-
-        while (pathProducer.getNumPathsAvailable() )
+    while( fftDataGenerator.getNumAvailableFFTDataBlocks() > 0 )
+    {
+        if( fftDataGenerator.getFFTData(fftData) )
         {
-            pathProducer.getPath(leftChannelFFTPath);
+            firstPathGenerator.generatePath(fftData, frequencies, fftBounds, -48.f);
+            if( source == AnalyzerSource_Post )
+            {
+                spectrogramData = fftData;
+                spectrogramDataIsNew = true;
+            }
         }
+    }
+    while( fftDataGenerator.getNumAvailableSecondFFTDataBlocks() > 0 )
+    {
+        if( fftDataGenerator.getSecondFFTData(fftData) )
+        {
+            secondPathGenerator.generatePath(fftData, frequencies, fftBounds, -48.f);
+            if( source == AnalyzerSource_PrePost )
+            {
+                spectrogramData = fftData;
+                spectrogramDataIsNew = true;
+            }
+        }
+    }
+
+    /*
+     while there are paths that can be pull
+        pull as many as we can
+            display the most recent path
+     */
+    while( firstPathGenerator.getNumPathsAvailable() )
+        firstPathGenerator.getPath(firstFFTPath);
+    while( secondPathGenerator.getNumPathsAvailable() )
+        secondPathGenerator.getPath(secondFFTPath);
+
+    if( source == AnalyzerSource_Difference || (source == AnalyzerSource_Post && display == AnalyzerDisplay_Sum) )
+        secondFFTPath.clear();
 }
 
 void ResponseCurveComponent::timerCallback()
@@ -294,10 +548,28 @@ void ResponseCurveComponent::timerCallback()
     auto fftBounds = getAnalysisArea().toFloat();
     auto sampleRate = audioProcessor.getSampleRate();
 
-    leftPathProducer.process(fftBounds, sampleRate);
-    rightPathProducer.process(fftBounds, sampleRate);
+    auto display = static_cast<AnalyzerDisplay>(audioProcessor.apvts.getRawParameterValue("Analyzer Display")->load());
+    analyzerSource = static_cast<AnalyzerSource>(audioProcessor.apvts.getRawParameterValue("Analyzer Source")->load());
+    auto trace = static_cast<ResponseTrace>(audioProcessor.apvts.getRawParameterValue("Response Trace")->load());
+    if( trace != responseTrace )
+    {
+        responseTrace = trace;
+        responseIsStale = true;
+    }
+    auto measuring = audioProcessor.apvts.getRawParameterValue("Measurement")->load() != (float) MeasurementSignal_Off;
+    if( audioProcessor.measurement.analyse() || measuring != showMeasurement )
+    {
+        showMeasurement = measuring;
+        responseIsStale = true;
+    }
+
+    pathProducer.process(fftBounds, sampleRate, analyzerSource, display);
+    
+    if( pathProducer.getSpectrogramData(spectrogramFrame) )
+        spectrogram.pushFrame(spectrogramFrame, -48.f);
     
-    if( parametersChanged.compareAndSetBool(false, true) )
+    // the sample rate isn't known before the processor is prepared
+    if( parametersChanged.compareAndSetBool(false, true) || sampleRate != designSampleRate )
     {
         updateChain();
     }
@@ -307,107 +579,234 @@ void ResponseCurveComponent::timerCallback()
 void ResponseCurveComponent::updateChain(){
     
     auto chainSettings = getChainSettings(audioProcessor.apvts);
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    auto peakCoefficients = makePeakFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    auto sampleRate = audioProcessor.getSampleRate();
+    if( sampleRate <= 0 )
+        return;
     
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
+    // the same cached designs the processor runs, in the topology it runs them in
+    if( sampleRate != designSampleRate )
+    {
+        designCascade.prepare(sampleRate);
+        designSvfChain.prepare({ sampleRate, 1, 1 });
+        designSampleRate = sampleRate;
+    }
+    updateCascade(designCascade, chainSettings, sampleRate);
+    auto svf = chainSettings.topology == Topology::Topology_SVF;
+    if( svf )
+        designSvfChain.update(chainSettings);
+    for( int lane = 0; lane < 2; ++lane )
+    {
+        ResponseEvaluator::collectSections(designCascade, lane, laneSections[lane]);
+        // with the SVF topology the cascade only has the extra bands
+        if( svf )
+            designSvfChain.collectSections(lane, laneSections[lane]);
+    }
+    responseIsStale = true;
     
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    // with any section on one lane only, left/mid and right/side get a curve each
+    lanesDiffer = chainSettings.lowCutPlacement != StereoPlacement_Both
+               || chainSettings.peakPlacement != StereoPlacement_Both
+               || chainSettings.highCutPlacement != StereoPlacement_Both;
+    for( const auto& band : chainSettings.bands )
+        lanesDiffer = lanesDiffer || (band.enabled && band.placement != StereoPlacement_Both);
 }
     void ResponseCurveComponent::paint (juce::Graphics& g)
     {
         
         using namespace juce;
         g.fillAll (Colours::white);
+        if( backgroundIsStale )
+            renderBackground();
         g.drawImage(background, getLocalBounds().toFloat());
         auto responseArea = getAnalysisArea();
-        auto w = responseArea.getWidth();
-        
-        auto &lowcut = monoChain.get<ChainPositions::LowCut>();
-        auto &peak = monoChain.get<ChainPositions::Peak>();
-        auto &highcut = monoChain.get<ChainPositions::HighCut>();
-        
-        auto sampleRate = audioProcessor.getSampleRate();
-        
-        std::vector<double> mags;
-        mags.resize(w);
-        
-        for( int  i = 0; i < w; ++i ){
-            double mag = 1.f;
-            auto freq = mapToLog10(double(i) / double(w), 20.0, 20000.0);
-            if( ! monoChain.isBypassed<ChainPositions::Peak>() )
-                mag *= peak.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !monoChain.isBypassed<ChainPositions::LowCut>() )
-            {
-                if( !lowcut.isBypassed<0>() )
-                    mag *= lowcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-                if( !lowcut.isBypassed<1>() )
-                    mag *= lowcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-                if( !lowcut.isBypassed<2>() )
-                    mag *= lowcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-                if( !lowcut.isBypassed<3>() )
-                    mag *= lowcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-
-            if( !monoChain.isBypassed<ChainPositions::HighCut>() )
-            {
-                if( !highcut.isBypassed<0>() )
-                    mag *= highcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-                if( !highcut.isBypassed<1>() )
-                    mag *= highcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-                if( !highcut.isBypassed<2>() )
-                    mag *= highcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-                if( !highcut.isBypassed<3>() )
-                    mag *= highcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-            mags[i] = Decibels::gainToDecibels(mag);
-        }
-        
-        Path responseCurve;
-        
-        const double outputMin = responseArea.getBottom();
-        const double outputMax = responseArea.getY();
-        auto map = [outputMin, outputMax](double input){
-            return jmap(input, -24.0, 24.0, outputMin, outputMax);
-        };
         
-        responseCurve.startNewSubPath(responseArea.getX(), map(mags.front()));
+        if( responseIsStale
+           || responseArea.getWidth() != responseEvaluator.getNumFrequencies()
+           || audioProcessor.getSampleRate() != responseEvaluator.getSampleRate() )
+            updateResponse();
         
-        for( size_t i = 1; i < mags.size(); ++i){
-            responseCurve.lineTo(responseArea.getX() + i, map(mags[i]));
-        }
-        auto leftChannelFFTPath = leftPathProducer.getPath();
-        g.setColour(Colours::pink);
-        leftChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
-        g.strokePath(leftChannelFFTPath, PathStrokeType(1.f));
-        auto rightChannelFFTPath = rightPathProducer.getPath();
-            rightChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+        auto firstFFTPath = pathProducer.getFirstPath();
+        g.setColour(analyzerSource == AnalyzerSource_Difference ? Colours::orange : Colours::pink);
+        firstFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+        g.strokePath(firstFFTPath, PathStrokeType(1.f));
+        auto secondFFTPath = pathProducer.getSecondPath();
+            secondFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
 
             g.setColour(Colours::lightyellow);
-            g.strokePath(rightChannelFFTPath, PathStrokeType(1.f));
+            g.strokePath(secondFFTPath, PathStrokeType(1.f));
         g.setColour(Colour::fromRGB(34, 34, 34));
         g.drawRoundedRectangle(getRenderArea().toFloat(),4.f, 2.f);
+        if( responseTrace != ResponseTrace_None )
+        {
+            g.setColour(Colours::teal);
+            g.strokePath(traceCurve, PathStrokeType(1.f));
+            g.setFont(ResponseGridLabels::FontHeight);
+            auto legend = responseTrace == ResponseTrace_Phase ? String("phase +/-180") : String("group delay 0-") + String(MaxGroupDelayMs) + " ms";
+            g.drawText(legend, responseArea.reduced(4).removeFromTop(ResponseGridLabels::FontHeight), Justification::topLeft, false);
+        }
+        if( lanesDiffer )
+        {
+            g.setColour(Colours::grey);
+            g.strokePath(secondLaneCurve, PathStrokeType(1.5f));
+        }
         g.setColour(Colours::black);
         g.strokePath(responseCurve, PathStrokeType(2.f));
+        if( showMeasurement && !measuredCurve.isEmpty() )
+        {
+            g.setColour(Colours::purple);
+            g.strokePath(measuredCurve, PathStrokeType(1.5f));
+            g.setFont(ResponseGridLabels::FontHeight);
+            g.drawText("measured, max deviation " + String(measurementDeviation, 2) + " dB",
+                       responseArea.reduced(4).removeFromBottom(ResponseGridLabels::FontHeight), Justification::bottomLeft, false);
+        }
+
+    }
+
+void ResponseCurveComponent::updateResponse(){
+    using namespace juce;
+    responseIsStale = false;
+    
+    auto responseArea = getAnalysisArea();
+    auto w = responseArea.getWidth();
+    auto sampleRate = audioProcessor.getSampleRate();
+    
+    // one frequency per pixel, set up again only when the width or the sample rate changes
+    if( w != responseEvaluator.getNumFrequencies() || sampleRate != responseEvaluator.getSampleRate() )
+    {
+        curveFrequencies.resize(w);
+        for( int i = 0; i < w; ++i )
+            curveFrequencies[i] = mapToLog10(double(i) / double(w), 20.0, 20000.0);
+        responseEvaluator.setFrequencies(curveFrequencies.data(), w, sampleRate);
+    }
+    
+    mags.resize(w);
+    secondLaneMags.resize(w);
+    traceValues.resize(w);
+    
+    auto* phase = responseTrace == ResponseTrace_Phase ? traceValues.data() : nullptr;
+    auto* groupDelay = responseTrace == ResponseTrace_GroupDelay ? traceValues.data() : nullptr;
+    responseEvaluator.evaluate(laneSections[0].data(), (int) laneSections[0].size(), mags.data(), phase, groupDelay);
+    if( lanesDiffer )
+        responseEvaluator.evaluate(laneSections[1].data(), (int) laneSections[1].size(), secondLaneMags.data(), nullptr, nullptr);
+    
+    responseCurve.clear();
+    secondLaneCurve.clear();
+    traceCurve.clear();
+    measuredCurve.clear();
+    if( w <= 0 )
+        return;
+    
+    const double outputMin = responseArea.getBottom();
+    const double outputMax = responseArea.getY();
+    auto map = [outputMin, outputMax](double input){
+        return jmap(input, -24.0, 24.0, outputMin, outputMax);
+    };
+    // the traces keep to the response area
+    auto mapTrace = [outputMin, outputMax](double input, double rangeMin, double rangeMax){
+        return jmap(jlimit(rangeMin, rangeMax, input), rangeMin, rangeMax, outputMin, outputMax);
+    };
+    
+    auto makeCurve = [&responseArea, &map](Path& curve, const std::vector<double>& curveMags)
+    {
+        curve.startNewSubPath(responseArea.getX(), map(curveMags.front()));
+        
+        for( size_t i = 1; i < curveMags.size(); ++i){
+            curve.lineTo(responseArea.getX() + i, map(curveMags[i]));
+        }
+    };
+    
+    makeCurve(responseCurve, mags);
+    if( lanesDiffer )
+        makeCurve(secondLaneCurve, secondLaneMags);
+    
+    if( showMeasurement && audioProcessor.measurement.hasResult() )
+    {
+        measuredMags.resize(w);
+        audioProcessor.measurement.getMagnitudeDb(curveFrequencies.data(), w, measuredMags.data());
+        makeCurve(measuredCurve, measuredMags);
+        
+        // only where the design passes something; deep in a cut the measurement is noise
+        measurementDeviation = 0;
+        for( int i = 0; i < w; ++i )
+        {
+            if( mags[i] > -40.0 )
+                measurementDeviation = jmax(measurementDeviation, std::abs(measuredMags[i] - mags[i]));
+        }
+    }
+    
+    if( responseTrace == ResponseTrace_Phase )
+    {
+        // the phase is wrapped; a jump of more than pi between pixels is the wrap, not the curve
+        traceCurve.startNewSubPath(responseArea.getX(), mapTrace(traceValues.front(), -MathConstants<double>::pi, MathConstants<double>::pi));
+        for( size_t i = 1; i < traceValues.size(); ++i )
+        {
+            auto y = mapTrace(traceValues[i], -MathConstants<double>::pi, MathConstants<double>::pi);
+            if( std::abs(traceValues[i] - traceValues[i - 1]) > MathConstants<double>::pi )
+                traceCurve.startNewSubPath(responseArea.getX() + i, y);
+            else
+                traceCurve.lineTo(responseArea.getX() + i, y);
+        }
+    }
+    else if( responseTrace == ResponseTrace_GroupDelay && sampleRate > 0 )
+    {
+        auto toMs = 1000.0 / sampleRate;
+        traceCurve.startNewSubPath(responseArea.getX(), mapTrace(traceValues.front() * toMs, 0.0, MaxGroupDelayMs));
+        for( size_t i = 1; i < traceValues.size(); ++i )
+            traceCurve.lineTo(responseArea.getX() + i, mapTrace(traceValues[i] * toMs, 0.0, MaxGroupDelayMs));
+    }
+}
+
+ResponseGridLabels::ResponseGridLabels()
+{
+    using namespace juce;
+    Font font(FontHeight);
+
+    auto add = [&font](std::vector<Label>& labels, float value, const String& str)
+    {
+        Label label { value, {}, font.getStringWidth(str) };
+        label.glyphs.addLineOfText(font, str, 0.f, font.getAscent());
+        labels.push_back(std::move(label));
+    };
 
+    for( float f : { 20.f, 50.f, 100.f, 200.f, 500.f, 1000.f, 2000.f, 5000.f, 10000.f, 20000.f } ){
+        auto value = f;
+        bool addK = false;
+        String str;
+        if ( f > 999.f ){
+            addK = true;
+            f /= 1000.f;
+        }
+        str << f;
+        if( addK )
+            str << "k";
+        str << "Hz";
+        add(frequencies, value, str);
+    }
+
+    for( float gDb : { -24.f, -12.f, 0.f, 12.f, 24.f } ){
+        String str;
+        if( gDb > 0)
+            str << "+";
+        str << gDb;
+        add(gains, gDb, str);
+
+        str.clear();
+        str << (gDb - 24.f);
+        add(analyzerGains, gDb, str);
     }
+}
 
 void ResponseCurveComponent::resized(){
+    backgroundIsStale = true;
+    responseIsStale = true;
+}
+
+void ResponseCurveComponent::renderBackground(){
     using namespace juce;
+    backgroundIsStale = false;
     background = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
     Graphics g(background);
-    Array<float> freqs
-    {
-        20, 50, 100,
-        200, 500, 1000,
-        2000, 5000, 10000,
-        20000
-    };
+    const auto& labels = *gridLabels;
     
     auto renderArea = getAnalysisArea();
     auto left = renderArea.getX();
@@ -418,8 +817,8 @@ void ResponseCurveComponent::resized(){
     
     Array<float> xs;
     
-    for( auto f : freqs ){
-        auto normX = mapFromLog10(f, 20.f, 20000.f);
+    for( const auto& label : labels.frequencies ){
+        auto normX = mapFromLog10(label.value, 20.f, 20000.f);
         xs.add(left + width * normX);
     }
     g.setColour(Colours::black);
@@ -427,61 +826,45 @@ void ResponseCurveComponent::resized(){
         g.drawVerticalLine(x, top, bottom);
     }
     
-    Array<float> gain{
-        -24, -12, 0, 12, 24
-    };
-    
-    for( auto gDb : gain ){
+    for( const auto& label : labels.gains ){
+        auto gDb = label.value;
         auto y = jmap(gDb, -24.f, 24.f, float(bottom), float(top));
         g.setColour(gDb == 0.f ? Colours::pink : Colours::darkgrey);
         g.drawHorizontalLine(y, left, right);
     }
     
+    const int fontHeight = ResponseGridLabels::FontHeight;
+    auto drawLabel = [&g](const ResponseGridLabels::Label& label, Rectangle<int> r)
+    {
+        label.glyphs.draw(g, AffineTransform::translation((float) r.getX(), (float) r.getY()));
+    };
+    
     g.setColour(Colours::black);
-    const int fontHeight = 10;
-    g.setFont(fontHeight);
-    for( int i = 0; i < freqs.size(); ++i ){
-        auto f = freqs[i];
-        auto x = xs[i];
-        bool addK = false;
-        String str;
-        if ( f > 999.f ){
-            addK = true;
-            f /= 1000.f;
-        }
-        str << f;
-        if( addK )
-            str << "k";
-        str << "Hz";
-        auto textWidth = g.getCurrentFont().getStringWidth(str);
+    for( int i = 0; i < (int) labels.frequencies.size(); ++i ){
+        const auto& label = labels.frequencies[i];
         Rectangle<int> r;
-        r.setSize(textWidth, fontHeight);
-        r.setCentre(x, 0);
+        r.setSize(label.width, fontHeight);
+        r.setCentre(xs[i], 0);
         r.setY(1);
         
-        g.drawFittedText(str, r, juce::Justification::centred, 1);
+        drawLabel(label, r);
     }
-    for( auto gDb : gain ){
+    for( int i = 0; i < (int) labels.gains.size(); ++i ){
+        const auto& label = labels.gains[i];
+        auto gDb = label.value;
         auto y = jmap(gDb, -24.f, 24.f, float(bottom), float(top));
-        String str;
-        if( gDb > 0)
-            str << "+";
-        str <<gDb;
-        auto textWidth = g.getCurrentFont().getStringWidth(str);
         Rectangle<int> r;
-        r.setSize(textWidth, fontHeight);
-        r.setX(getWidth()-textWidth);
+        r.setSize(label.width, fontHeight);
+        r.setX(getWidth()-label.width);
         r.setCentre(r.getCentreX(), y);
         g.setColour(gDb == 0.f ? Colours::pink : Colours::black);
-        g.drawFittedText(str, r, juce::Justification::centred, 1);
-        str.clear();
-        str << (gDb - 24.f);
+        drawLabel(label, r);
 
+        const auto& analyzerLabel = labels.analyzerGains[i];
         r.setX(1);
-        textWidth = g.getCurrentFont().getStringWidth(str);
-        r.setSize(textWidth, fontHeight);
+        r.setSize(analyzerLabel.width, fontHeight);
         g.setColour(Colours::black);
-        g.drawFittedText(str, r, juce::Justification::centred, 1);
+        drawLabel(analyzerLabel, r);
     }
 }
 
@@ -501,6 +884,57 @@ juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea(){
     return bounds;
 }
 //==============================================================================
+// a ComboBoxAttachment picks items by index, so the box needs the choices first
+static void addChoices(juce::ComboBox& box, juce::AudioProcessorValueTreeState& apvts, const juce::String& id)
+{
+    if( auto* choice = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter(id)) )
+        box.addItemList(choice->choices, 1);
+}
+
+ParameterControl::ParameterControl(juce::AudioProcessorValueTreeState& apvts, const juce::String& parameterID, const juce::String& caption)
+{
+    using namespace juce;
+
+    label.setText(caption, dontSendNotification);
+    label.setFont(12.f);
+    label.setJustificationType(Justification::centred);
+    label.setColour(Label::textColourId, Colour::fromRGB(34, 34, 34));
+    addAndMakeVisible(label);
+
+    auto* param = apvts.getParameter(parameterID);
+    if( dynamic_cast<AudioParameterChoice*>(param) != nullptr )
+    {
+        addChoices(box, apvts, parameterID);
+        boxAttachment = std::make_unique<APVTS::ComboBoxAttachment>(apvts, parameterID, box);
+        control = &box;
+    }
+    else if( dynamic_cast<AudioParameterBool*>(param) != nullptr )
+    {
+        toggle.setLookAndFeel(&lnf.get());
+        toggleAttachment = std::make_unique<APVTS::ButtonAttachment>(apvts, parameterID, toggle);
+        control = &toggle;
+    }
+    else
+    {
+        bar.setColour(Slider::textBoxTextColourId, Colour::fromRGB(34, 34, 34));
+        barAttachment = std::make_unique<APVTS::SliderAttachment>(apvts, parameterID, bar);
+        control = &bar;
+    }
+    addAndMakeVisible(*control);
+}
+
+ParameterControl::~ParameterControl()
+{
+    toggle.setLookAndFeel(nullptr);
+}
+
+void ParameterControl::resized()
+{
+    auto bounds = getLocalBounds();
+    label.setBounds(bounds.removeFromTop(14));
+    control->setBounds(bounds.reduced(2));
+}
+
 EqualizerAudioProcessorEditor::EqualizerAudioProcessorEditor (EqualizerAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p),
 peakFreqSlider(*audioProcessor.apvts.getParameter("Peak Freq"),"Hz"),
@@ -510,7 +944,8 @@ lowCutFreqSlider(*audioProcessor.apvts.getParameter("LowCut Freq"), "Hz"),
 highCutFreqSlider(*audioProcessor.apvts.getParameter("HighCut Freq"), "Hz"),
 lowCutSlopeSlider(*audioProcessor.apvts.getParameter("LowCut Slope"), "db/Oct"),
 highCutSlopeSlider(*audioProcessor.apvts.getParameter("HighCut Slope"), "db/Oct"),
-responseCurveComponent(audioProcessor),
+meterComponent(audioProcessor),
+responseCurveComponent(audioProcessor, spectrogramComponent),
 peakFreqSliderAttachment(audioProcessor.apvts, "Peak Freq", peakFreqSlider),
 peakGainSliderAttachment(audioProcessor.apvts, "Peak Gain", peakGainSlider),
 peakQualitySliderAttachment(audioProcessor.apvts, "Peak Quality", peakQualitySlider),
@@ -522,7 +957,9 @@ highCutSlopeSliderAttachment(audioProcessor.apvts, "HighCut Slope", highCutSlope
 lowcutBypassButtonAttachment(audioProcessor.apvts, "LowCut Bypassed", lowcutBypassButton),
 peakBypassButtonAttachment(audioProcessor.apvts, "Peak Bypassed", peakBypassButton),
 highcutBypassButtonAttachment(audioProcessor.apvts, "HighCut Bypassed", highcutBypassButton),
-analyzerEnabledButtonAttachment(audioProcessor.apvts, "Analyzer Enabled", analyzerEnabledButton)
+analyzerEnabledButtonAttachment(audioProcessor.apvts, "Analyzer Enabled", analyzerEnabledButton),
+morphButtonAttachment(audioProcessor.apvts, "Morph", morphButton),
+morphAmountSliderAttachment(audioProcessor.apvts, "Morph Amount", morphAmountSlider)
 {
 
     peakFreqSlider.labels.add({0.f, "20Hz"});
@@ -540,17 +977,57 @@ analyzerEnabledButtonAttachment(audioProcessor.apvts, "Analyzer Enabled", analyz
     highCutSlopeSlider.labels.add({0.f, "12"});
     highCutSlopeSlider.labels.add({1.f,"48"});
 
+    // the slots are the ones 'Morph From' offers
+    addChoices(snapshotSlotBox, audioProcessor.apvts, "Morph From");
+    addChoices(morphFromBox, audioProcessor.apvts, "Morph From");
+    addChoices(morphToBox, audioProcessor.apvts, "Morph To");
+    morphFromBoxAttachment = std::make_unique<APVTS::ComboBoxAttachment>(audioProcessor.apvts, "Morph From", morphFromBox);
+    morphToBoxAttachment = std::make_unique<APVTS::ComboBoxAttachment>(audioProcessor.apvts, "Morph To", morphToBox);
+    snapshotSlotBox.setSelectedItemIndex(0, juce::dontSendNotification);
+    snapshotSlotBox.onChange = [this] { updateSnapshotButtons(); };
+    storeSnapshotButton.onClick = [this]
+    {
+        audioProcessor.storeSnapshot(snapshotSlotBox.getSelectedItemIndex());
+        updateSnapshotButtons();
+    };
+    recallSnapshotButton.onClick = [this] { audioProcessor.recallSnapshot(snapshotSlotBox.getSelectedItemIndex()); };
+    updateSnapshotButtons();
+    morphButton.setColour(juce::ToggleButton::textColourId, juce::Colour::fromRGB(34, 34, 34));
+    morphButton.setColour(juce::ToggleButton::tickColourId, juce::Colour::fromRGB(34, 34, 34));
+    morphButton.setColour(juce::ToggleButton::tickDisabledColourId, juce::Colours::darkgrey);
+
+    addControls(processingControls, { { "Filter Topology", "Topology" }, { "Peak Design", "Peak Design" },
+                                      { "Processing Precision", "Precision" }, { "Parallel Channels", "Parallel" },
+                                      { "Stereo Mode", "Stereo" }, { "Auto Gain", "Auto Gain" } });
+    peakDesignControl = processingControls[1].get();
+    addControls(dynamicsControls, { { "Peak Dynamic", "Dynamic Peak" }, { "Peak Threshold", "Threshold" },
+                                    { "Peak Ratio", "Ratio" }, { "Peak Attack", "Attack" },
+                                    { "Peak Release", "Release" }, { "Peak Channel", "Peak On" } });
+    addControls(displayControls, { { "LowCut Channel", "LowCut On" }, { "HighCut Channel", "HighCut On" },
+                                   { "Analyzer Source", "Analyzer" }, { "Analyzer Display", "Display" },
+                                   { "Response Trace", "Trace" }, { "Measurement", "Measure" } });
+    for( int b = 0; b < MaxBands; ++b )
+        bandBox.addItem("Band " + juce::String(b + 1), b + 1);
+    bandBox.setSelectedItemIndex(0, juce::dontSendNotification);
+    bandBox.onChange = [this] { showBand(bandBox.getSelectedItemIndex()); };
+    showBand(0);
+
+    audioProcessor.apvts.addParameterListener("Filter Topology", this);
+    handleAsyncUpdate();
+
     for (auto* comp : getComps()){
         addAndMakeVisible(comp);
     }
-    peakBypassButton.setLookAndFeel(&lnf);
-        lowcutBypassButton.setLookAndFeel(&lnf);
-        highcutBypassButton.setLookAndFeel(&lnf);
-    setSize (600, 480);
+    peakBypassButton.setLookAndFeel(&lnf.get());
+        lowcutBypassButton.setLookAndFeel(&lnf.get());
+        highcutBypassButton.setLookAndFeel(&lnf.get());
+    setSize (600, 590 + 4 * ControlRowHeight);
     
 }
 
 EqualizerAudioProcessorEditor::~EqualizerAudioProcessorEditor(){
+    audioProcessor.apvts.removeParameterListener("Filter Topology", this);
+    cancelPendingUpdate();
 
     peakBypassButton.setLookAndFeel(nullptr);
      lowcutBypassButton.setLookAndFeel(nullptr);
@@ -567,12 +1044,75 @@ void EqualizerAudioProcessorEditor::paint (juce::Graphics& g)
 }
 
 
+void EqualizerAudioProcessorEditor::updateSnapshotButtons()
+{
+    recallSnapshotButton.setEnabled(audioProcessor.hasSnapshot(snapshotSlotBox.getSelectedItemIndex()));
+}
+
+// may come from the audio thread, when the host automates the topology
+void EqualizerAudioProcessorEditor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    triggerAsyncUpdate();
+}
+
+void EqualizerAudioProcessorEditor::handleAsyncUpdate()
+{
+    auto topology = static_cast<Topology>(audioProcessor.apvts.getRawParameterValue("Filter Topology")->load());
+    peakDesignControl->setEnabled(topology != Topology::Topology_SVF);
+}
+
+void EqualizerAudioProcessorEditor::addControls(ParameterControls& controls, std::initializer_list<std::pair<juce::String, juce::String>> idsAndCaptions)
+{
+    for( const auto& [id, caption] : idsAndCaptions )
+    {
+        controls.push_back(std::make_unique<ParameterControl>(audioProcessor.apvts, id, caption));
+        addAndMakeVisible(*controls.back());
+    }
+}
+
+void EqualizerAudioProcessorEditor::showBand(int band)
+{
+    bandControls.clear();
+    auto prefix = "Band " + juce::String(band + 1) + " ";
+    addControls(bandControls, { { prefix + "Enabled", "On" }, { prefix + "Type", "Type" }, { prefix + "Freq", "Freq" },
+                                { prefix + "Gain", "Gain" }, { prefix + "Quality", "Q" }, { prefix + "Channel", "Channel" } });
+    resized();
+}
+
+void EqualizerAudioProcessorEditor::layOutRow(ParameterControls& controls, juce::Rectangle<int> area)
+{
+    auto width = area.getWidth() / juce::jmax(1, (int) controls.size());
+    for( auto& control : controls )
+        control->setBounds(area.removeFromLeft(width));
+}
+
 void EqualizerAudioProcessorEditor::resized()
 {
     auto bounds = getLocalBounds();
+    auto snapshotArea = bounds.removeFromBottom(30).reduced(20, 4);
+    snapshotSlotBox.setBounds(snapshotArea.removeFromLeft(60));
+    storeSnapshotButton.setBounds(snapshotArea.removeFromLeft(60).withTrimmedLeft(4));
+    recallSnapshotButton.setBounds(snapshotArea.removeFromLeft(60).withTrimmedLeft(4));
+    snapshotArea.removeFromLeft(20);
+    morphButton.setBounds(snapshotArea.removeFromLeft(70));
+    morphFromBox.setBounds(snapshotArea.removeFromLeft(60));
+    morphToBox.setBounds(snapshotArea.removeFromRight(60));
+    morphAmountSlider.setBounds(snapshotArea.reduced(4, 0));
+    
+    auto controlsArea = bounds.removeFromBottom(4 * ControlRowHeight).reduced(20, 0);
+    layOutRow(processingControls, controlsArea.removeFromTop(ControlRowHeight));
+    layOutRow(dynamicsControls, controlsArea.removeFromTop(ControlRowHeight));
+    layOutRow(displayControls, controlsArea.removeFromTop(ControlRowHeight));
+    bandBox.setBounds(controlsArea.removeFromLeft(80).withTrimmedTop(14).reduced(2));
+    layOutRow(bandControls, controlsArea);
+    
     auto responseArea = bounds.removeFromTop(bounds.getHeight() * 0.33);
     
     responseCurveComponent.setBounds(responseArea);
+    auto spectrogramArea = bounds.removeFromTop(80).reduced(20, 4);
+    meterComponent.setBounds(spectrogramArea.removeFromRight(160));
+    spectrogramArea.removeFromRight(4);
+    spectrogramComponent.setBounds(spectrogramArea);
     
     auto lowCutArea = bounds.removeFromLeft(bounds.getWidth() * 0.33);
     auto highCutArea = bounds.removeFromRight(bounds.getWidth() * 0.5);
@@ -604,9 +1144,19 @@ std::vector<juce::Component*> EqualizerAudioProcessorEditor::getComps()
         &lowCutSlopeSlider,
         &highCutSlopeSlider,
         &responseCurveComponent,
+        &spectrogramComponent,
+        &meterComponent,
         &lowcutBypassButton,
         &peakBypassButton,
         &highcutBypassButton,
-        &analyzerEnabledButton
+        &analyzerEnabledButton,
+        &snapshotSlotBox,
+        &storeSnapshotButton,
+        &recallSnapshotButton,
+        &morphButton,
+        &morphFromBox,
+        &morphAmountSlider,
+        &morphToBox,
+        &bandBox
     };
  }
@@ -10,6 +10,7 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "ResponseEvaluator.h"
 
 enum FFTOrder
 {
@@ -18,72 +19,277 @@ enum FFTOrder
     order8192 = 13
 };
 
-template<typename BlockType>
-struct FFTDataGenerator
+/*
+ Both channels of the analyzer from one complex FFT: left goes in the real part and right in
+ the imaginary part, and the two spectra are separated afterwards using the conjugate symmetry
+ of a real signal's spectrum,
+     L[k] = (Z[k] + conj(Z[N-k])) / 2,   R[k] = (Z[k] - conj(Z[N-k])) / 2j.
+ Mid/side and the sum are linear in L and R, so they come from the same transform.
+ */
+struct StereoFFT
 {
     /**
-     produces the FFT data from an audio buffer.
+     normalized magnitudes of the first getFFTSize() / 2 bins of both traces, from two
+     channels of getFFTSize() samples.
      */
-    void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
+    void produceMagnitudes(const float* left, const float* right, AnalyzerDisplay display,
+                           float* firstMagnitudes, float* secondMagnitudes)
     {
         const auto fftSize = getFFTSize();
 
-        fftData.assign(fftData.size(), 0);
-        auto* readIndex = audioData.getReadPointer(0);
-        std::copy(readIndex, readIndex + fftSize, fftData.begin());
-
-        // first apply a windowing function to our data
-        window->multiplyWithWindowingTable (fftData.data(), fftSize);       // [1]
+        // window both channels on the way in
+        for( int i = 0; i < fftSize; ++i )
+            timeData[i] = { left[i] * windowTable[i], right[i] * windowTable[i] };
 
-        // then render our FFT data..
-        forwardFFT->performFrequencyOnlyForwardTransform (fftData.data());  // [2]
+        forwardFFT->perform(timeData.data(), frequencyData.data(), false);
 
         int numBins = (int)fftSize / 2;
+        const std::complex<float> minusHalfJ { 0.f, -0.5f };
 
-        //normalize the fft values.
-        for( int i = 0; i < numBins; ++i )
+        for( int k = 0; k < numBins; ++k )
         {
-            fftData[i] /= (float) numBins;
-        }
+            auto z = frequencyData[k];
+            auto mirrored = std::conj(frequencyData[(fftSize - k) & (fftSize - 1)]);
+            auto l = (z + mirrored) * 0.5f;
+            auto r = (z - mirrored) * minusHalfJ;
 
-        //convert them to decibels
-        for( int i = 0; i < numBins; ++i )
-        {
-            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
-        }
+            std::complex<float> first, second;
+            switch( display )
+            {
+                case AnalyzerDisplay_LeftRight: first = l; second = r; break;
+                case AnalyzerDisplay_MidSide: first = (l + r) * 0.5f; second = (l - r) * 0.5f; break;
+                case AnalyzerDisplay_Sum: first = l + r; break;
+            }
 
-        fftDataFifo.push(fftData);
+            //normalize the fft values.
+            firstMagnitudes[k] = std::abs(first) / (float) numBins;
+            secondMagnitudes[k] = std::abs(second) / (float) numBins;
+        }
     }
 
     void changeOrder(FFTOrder newOrder)
     {
-        //when you change order, recreate the window, forwardFFT, fifo, fftData
-        //also reset the fifoIndex
-        //things that need recreating should be created on the heap via std::make_unique<>
-
         order = newOrder;
         auto fftSize = getFFTSize();
 
         forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
 
-        fftData.clear();
-        fftData.resize(fftSize * 2, 0);
+        windowTable.assign(fftSize, 1.f);
+        juce::dsp::WindowingFunction<float>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris)
+            .multiplyWithWindowingTable(windowTable.data(), fftSize);
 
-        fftDataFifo.prepare(fftData.size());
+        timeData.assign(fftSize, {});
+        frequencyData.assign(fftSize, {});
     }
     //==============================================================================
     int getFFTSize() const { return 1 << order; }
-    int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
-    //==============================================================================
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
 private:
     FFTOrder order;
-    BlockType fftData;
+    std::vector<float> windowTable;
+    std::vector<std::complex<float>> timeData, frequencyData;
     std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+};
+
+/*
+ A multi-resolution analyzer: the same FFT size runs on the input and on copies decimated by
+ 2, 4 and 8, and each log-spaced output point is read from the most decimated level that still
+ covers it. Low frequencies get the resolution of an FFT eight times longer and high
+ frequencies keep the short window, so transients aren't smeared.
+
+ Level k runs at fs / 2^k. The decimating lowpass before level k + 1 leaves it alias-free up to
+ a quarter of its own rate, which is where it takes over from level k. With NumLevels = 4
+ and 2048 points that is four 2048-point transforms per frame, less work than one at 8192.
+ */
+template<typename BlockType>
+struct MultiResolutionFFTDataGenerator
+{
+    static constexpr int NumLevels = 4;
+    static constexpr int NumPoints = 512;
+
+    void prepare(FFTOrder order, double sampleRate)
+    {
+        transform.changeOrder(order);
+        fftSize = transform.getFFTSize();
+        const auto numBins = fftSize / 2;
+
+        for( auto& level : levels )
+        {
+            level.history.setSize(2, fftSize);
+            level.firstMagnitudes.assign(numBins, 0.f);
+            level.secondMagnitudes.assign(numBins, 0.f);
+        }
+        unwrapped.setSize(2, fftSize);
+
+        // each decimator is designed at the rate of the level feeding it
+        for( int k = 1; k < NumLevels; ++k )
+        {
+            auto inputRate = sampleRate / double(1 << (k - 1));
+            auto coefficients = juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(0.15 * inputRate, inputRate, 8);
+            for( auto& channel : levels[k].decimator )
+                for( int stage = 0; stage < DecimatorStages; ++stage )
+                    channel[stage].coefficients = coefficients[stage];
+        }
+
+        buildPoints(sampleRate);
+        reset();
+
+        firstData.assign(NumPoints, 0.f);
+        secondData.assign(NumPoints, 0.f);
+        firstFifo.prepare(firstData.size());
+        secondFifo.prepare(secondData.size());
+    }
+
+    // forget the signal so far, e.g. when the analyzer starts looking at a different one
+    void reset()
+    {
+        for( auto& level : levels )
+        {
+            level.history.clear();
+            level.writeIndex = 0;
+            level.phase = 0;
+            for( auto& channel : level.decimator )
+                for( auto& stage : channel )
+                    stage.reset();
+        }
+    }
+
+    void push(const float* left, const float* right, int numSamples)
+    {
+        for( int i = 0; i < numSamples; ++i )
+            pushSample(0, left[i], right[i]);
+    }
+
+    /**
+     produces the log-spaced FFT data for both traces from everything pushed so far.
+     */
+    void produceFFTDataForRendering(AnalyzerDisplay display, const float negativeInfinity)
+    {
+        for( auto& level : levels )
+        {
+            // oldest sample first
+            for( int ch = 0; ch < 2; ++ch )
+            {
+                auto* source = level.history.getReadPointer(ch);
+                auto* dest = unwrapped.getWritePointer(ch);
+                std::copy(source + level.writeIndex, source + fftSize, dest);
+                std::copy(source, source + level.writeIndex, dest + fftSize - level.writeIndex);
+            }
+
+            transform.produceMagnitudes(unwrapped.getReadPointer(0), unwrapped.getReadPointer(1), display,
+                                        level.firstMagnitudes.data(), level.secondMagnitudes.data());
+        }
+
+        for( int p = 0; p < NumPoints; ++p )
+        {
+            const auto& point = points[p];
+            const auto& level = levels[point.level];
+
+            //convert them to decibels
+            firstData[p] = juce::Decibels::gainToDecibels(readPoint(level.firstMagnitudes, point), negativeInfinity);
+            secondData[p] = juce::Decibels::gainToDecibels(readPoint(level.secondMagnitudes, point), negativeInfinity);
+        }
+
+        firstFifo.push(firstData);
+        if( display != AnalyzerDisplay_Sum )
+            secondFifo.push(secondData);
+    }
+    //==============================================================================
+    int getFFTSize() const { return fftSize; }
+    // the centre frequency of every output point, in Hz
+    const std::vector<float>& getFrequencies() const { return frequencies; }
+    int getNumAvailableFFTDataBlocks() const { return firstFifo.getNumAvailableForReading(); }
+    int getNumAvailableSecondFFTDataBlocks() const { return secondFifo.getNumAvailableForReading(); }
+    //==============================================================================
+    bool getFFTData(BlockType& fftData) { return firstFifo.pull(fftData); }
+    bool getSecondFFTData(BlockType& fftData) { return secondFifo.pull(fftData); }
+private:
+    static constexpr int DecimatorStages = 4;
+
+    struct Level
+    {
+        juce::AudioBuffer<float> history;
+        int writeIndex { 0 };
+        // the lowpass in front of this level, and which input sample it keeps
+        std::array<std::array<juce::dsp::IIR::Filter<float>, DecimatorStages>, 2> decimator;
+        int phase { 0 };
+        std::vector<float> firstMagnitudes, secondMagnitudes;
+    };
+
+    // where an output point reads its level: the peak over [firstBin, lastBin] when the point
+    // spans several bins, otherwise the bins either side of 'position' interpolated
+    struct Point
+    {
+        int level, firstBin, lastBin;
+        float position;
+    };
+
+    void pushSample(int k, float left, float right)
+    {
+        auto& level = levels[k];
+        level.history.setSample(0, level.writeIndex, left);
+        level.history.setSample(1, level.writeIndex, right);
+        level.writeIndex = (level.writeIndex + 1) % fftSize;
+
+        if( k + 1 == NumLevels )
+            return;
+
+        auto& next = levels[k + 1];
+        for( auto& stage : next.decimator[0] )
+            left = stage.processSample(left);
+        for( auto& stage : next.decimator[1] )
+            right = stage.processSample(right);
+
+        next.phase ^= 1;
+        if( next.phase == 0 )
+            pushSample(k + 1, left, right);
+    }
+
+    void buildPoints(double sampleRate)
+    {
+        const auto numBins = fftSize / 2;
+        const auto spacing = std::pow(1000.0, 1.0 / double(NumPoints - 1));
+        frequencies.resize(NumPoints);
+
+        for( int p = 0; p < NumPoints; ++p )
+        {
+            auto freq = 20.0 * std::pow(spacing, double(p));
+            frequencies[p] = (float) freq;
+
+            int k = NumLevels - 1;
+            while( k > 0 && freq > sampleRate / double(1 << (k + 2)) )
+                --k;
+
+            auto binWidth = sampleRate / double(1 << k) / double(fftSize);
+            auto lowBin = freq / std::sqrt(spacing) / binWidth;
+            auto highBin = freq * std::sqrt(spacing) / binWidth;
+
+            auto& point = points[p];
+            point.level = k;
+            point.firstBin = juce::jlimit(0, numBins - 1, (int) std::ceil(lowBin));
+            point.lastBin = juce::jlimit(0, numBins - 1, (int) std::floor(highBin));
+            point.position = (float) juce::jlimit(0.0, double(numBins - 2), freq / binWidth);
+        }
+    }
+
+    static float readPoint(const std::vector<float>& magnitudes, const Point& point)
+    {
+        if( point.lastBin > point.firstBin )
+            return *std::max_element(magnitudes.begin() + point.firstBin, magnitudes.begin() + point.lastBin + 1);
 
-    Fifo<BlockType> fftDataFifo;
+        auto bin = (int) point.position;
+        auto frac = point.position - (float) bin;
+        return magnitudes[bin] + frac * (magnitudes[bin + 1] - magnitudes[bin]);
+    }
+
+    StereoFFT transform;
+    int fftSize { 0 };
+    std::array<Level, NumLevels> levels;
+    juce::AudioBuffer<float> unwrapped;
+    std::array<Point, NumPoints> points;
+    std::vector<float> frequencies;
+    BlockType firstData, secondData;
+
+    Fifo<BlockType> firstFifo, secondFifo;
 };
 
 template<typename PathType>
@@ -91,39 +297,45 @@ template<typename PathType>
 struct AnalyzerPathGenerator
 {
     /*
-     converts 'renderData[]' into a juce::Path
+     converts 'renderData[]', one value per entry of 'binFrequencies', into a juce::Path
      */
     void generatePath(const std::vector<float>& renderData,
+                      const std::vector<float>& binFrequencies,
                       juce::Rectangle<float> fftBounds,
-                      int fftSize,
-                      float binWidth,
-                      float negativeInfinity)
+                      float negativeInfinity,
+                      float maxDecibels = 0.f)
     {
         auto top = fftBounds.getY();
         auto bottom = fftBounds.getHeight();
         auto width = fftBounds.getWidth();
 
-        int numBins = (int)fftSize / 2;
+        jassert(renderData.size() == binFrequencies.size());
+        auto numBins = (int) renderData.size();
 
         PathType p;
-        p.preallocateSpace(3 * (int)fftBounds.getWidth());
+        p.preallocateSpace(3 * numBins);
 
-        auto map = [bottom, top, negativeInfinity](float v)
+        auto map = [bottom, top, negativeInfinity, maxDecibels](float v)
         {
             return juce::jmap(v,
-                              negativeInfinity, 0.f,
+                              negativeInfinity, maxDecibels,
                               float(bottom),   top);
         };
 
+        auto binX = [width](float binFreq)
+        {
+            auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
+            return std::floor(normalizedBinX * width);
+        };
+
         auto y = map(renderData[0]);
 
         jassert( !std::isnan(y) && !std::isinf(y) );
 
-        p.startNewSubPath(0, y);
-
-        const int pathResolution = 2; //you can draw line-to's every 'pathResolution' pixels.
+        p.startNewSubPath(binX(binFrequencies[0]), y);
 
-        for( int binNum = 1; binNum < numBins; binNum += pathResolution )
+        // the bins are already log-spaced, so every one of them gets a point
+        for( int binNum = 1; binNum < numBins; ++binNum )
         {
             y = map(renderData[binNum]);
 
@@ -131,10 +343,7 @@ struct AnalyzerPathGenerator
 
             if( !std::isnan(y) && !std::isinf(y) )
             {
-                auto binFreq = binNum * binWidth;
-                auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
-                int binX = std::floor(normalizedBinX * width);
-                p.lineTo(binX, y);
+                p.lineTo(binX(binFrequencies[binNum]), y);
             }
         }
 
@@ -165,15 +374,26 @@ struct LookAndFeel : juce::LookAndFeel_V4{
                               juce::ToggleButton & toggleButton,
                               bool shouldDrawButtonAsHighlighted,
                               bool shouldDrawButtonAsDown) override;
+
+    /*
+     The shapes drawRotarySlider draws, for sliders that keep them between paints. The arcs
+     come back already stroked, ready to fill. The background arc only depends on the bounds;
+     the value arc and the stick also depend on 'toAngle'.
+     */
+    static juce::Path createRotaryBackground(juce::Rectangle<float> bounds, float rotaryStartAngle, float rotaryEndAngle);
+    static void createRotaryValue(juce::Rectangle<float> bounds, float rotaryStartAngle, float toAngle,
+                                  juce::Path& valueArc, juce::Path& stick);
 };
 
 struct RotarySliderWithLabels: juce::Slider {
     RotarySliderWithLabels(juce::RangedAudioParameter &rap, const juce::String &unitSuffix) :
     juce::Slider(juce::Slider::SliderStyle::RotaryVerticalDrag,juce::Slider::TextEntryBoxPosition::NoTextBox),
     param(&rap),
+    choiceParam(dynamic_cast<juce::AudioParameterChoice*>(&rap)),
+    isFloatParam(dynamic_cast<juce::AudioParameterFloat*>(&rap) != nullptr),
     suffix(unitSuffix)
     {
-        setLookAndFeel(&lnf);
+        setLookAndFeel(&lnf.get());
     }
     ~RotarySliderWithLabels()
     {
@@ -184,44 +404,171 @@ struct RotarySliderWithLabels: juce::Slider {
         float pos;
         juce::String label;
     };
+    // set before the slider is first shown
     juce::Array<LabelPos> labels;
     void paint(juce::Graphics& g) override;
+    void resized() override;
+    void valueChanged() override;
     juce::Rectangle<int> getSliderBounds() const;
     int getTextHeight() const { return 14; }
     juce::String getDisplayString() const;
 private:
-    LookAndFeel lnf;
+    // one instance for every slider and editor in the process
+    juce::SharedResourcePointer<LookAndFeel> lnf;
     juce::RangedAudioParameter* param;
+    // what kind of parameter it is, found once rather than on every display string
+    juce::AudioParameterChoice* choiceParam;
+    bool isFloatParam;
     juce::String suffix;
+
+    /*
+     Everything paint draws, kept between paints: the background arc and the range labels
+     change with the size only, the value arc, the pointer and the value text with the value
+     too. Host automation then costs a few filled paths per knob, not a re-layout.
+     */
+    void updateStaticShapes();
+    void updateValueShapes();
+    bool staticShapesAreStale { true }, valueShapesAreStale { true };
+    juce::Path backgroundArc;
+    juce::GlyphArrangement rangeLabels;
+    juce::Path valueArc, stick, pointer;
+    juce::Rectangle<float> knob, textBox;
+    juce::GlyphArrangement valueText;
+};
+
+/*
+ A caption over the control of a parameter that has no knob: a combo box for a choice, a power
+ button for a bool and a bar for anything else, attached to the parameter.
+ */
+struct ParameterControl : juce::Component
+{
+    ParameterControl(juce::AudioProcessorValueTreeState& apvts, const juce::String& parameterID, const juce::String& caption);
+    ~ParameterControl() override;
+    void resized() override;
+private:
+    using APVTS = juce::AudioProcessorValueTreeState;
+    juce::SharedResourcePointer<LookAndFeel> lnf;
+    juce::Label label;
+    juce::ComboBox box;
+    juce::ToggleButton toggle;
+    juce::Slider bar { juce::Slider::LinearBar, juce::Slider::TextBoxLeft };
+    juce::Component* control { nullptr };
+    std::unique_ptr<APVTS::ComboBoxAttachment> boxAttachment;
+    std::unique_ptr<APVTS::ButtonAttachment> toggleAttachment;
+    std::unique_ptr<APVTS::SliderAttachment> barAttachment;
 };
 
+/*
+ The one reader of the processor's AnalyzerCapture: pulls whatever the audio thread has
+ published since the last timer tick into the multi-resolution generator and turns it into at
+ most two traces. Pre and post share a single complex FFT the same way left and right do.
+ */
 struct PathProducer
 {
-    PathProducer(SingleChannelSampleFifo<EqualizerAudioProcessor::BlockType>& scsf) :
-    leftChannelFifo(&scsf)
+    PathProducer(AnalyzerCapture& analyzerCapture) :
+    capture(&analyzerCapture)
     {
-        leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-        monoBuffer.setSize(1, leftChannelFFTDataGenerator.getFFTSize());
+        // enough for a timer tick at high sample rates; anything older is dropped by the capture
+        window.setSize(AnalyzerCapture::NumTaps, 1 << 13);
+        window.clear();
+        preSignal.resize(window.getNumSamples());
+        postSignal.resize(window.getNumSamples());
     }
-    void process(juce::Rectangle<float> fftBounds, double sampleRate);
-    juce::Path getPath() { return leftChannelFFTPath; }
+    void process(juce::Rectangle<float> fftBounds, double sampleRate, AnalyzerSource source, AnalyzerDisplay display);
+    // post: left, mid or the sum, depending on the display; pre/post: pre; difference: post minus pre
+    juce::Path getFirstPath() { return firstFFTPath; }
+    // post: right or side, empty for the sum; pre/post: post; difference: empty
+    juce::Path getSecondPath() { return secondFFTPath; }
+    // the post-EQ trace of the latest frame in dB, if there has been a new one since the last call
+    bool getSpectrogramData(std::vector<float>& dest);
 private:
-    SingleChannelSampleFifo<EqualizerAudioProcessor::BlockType>* leftChannelFifo;
+    AnalyzerCapture* capture;
+
+    std::vector<float> spectrogramData;
+    bool spectrogramDataIsNew { false };
 
-    juce::AudioBuffer<float> monoBuffer;
+    juce::AudioBuffer<float> window;
+    std::vector<float> preSignal, postSignal, differenceData;
+    void mixDown(int leftTap, AnalyzerDisplay display, int start, int numSamples, std::vector<float>& dest) const;
+    void pushToGenerator(AnalyzerSource source, AnalyzerDisplay display, int start, int numSamples);
 
-    FFTDataGenerator<std::vector<float>> leftChannelFFTDataGenerator;
+    MultiResolutionFFTDataGenerator<std::vector<float>> fftDataGenerator;
+    double preparedSampleRate { 0 };
+    AnalyzerSource feedingSource { AnalyzerSource_Post };
+    AnalyzerDisplay feedingDisplay { AnalyzerDisplay_LeftRight };
 
-    AnalyzerPathGenerator<juce::Path> pathProducer;
+    AnalyzerPathGenerator<juce::Path> firstPathGenerator, secondPathGenerator;
 
-    juce::Path leftChannelFFTPath;
+    juce::Path firstFFTPath, secondFFTPath;
+};
+
+/*
+ A scrolling spectrogram of the analyzer's post-EQ trace. Time runs left to right, one column
+ per analyzer frame, written straight into a preallocated image that is used as a ring: the
+ write column wraps around, and paint draws the two halves of the ring oldest first. The image
+ is all the memory it uses, however long the session runs.
+ */
+struct SpectrogramComponent : juce::Component
+{
+    SpectrogramComponent();
+
+    void pushFrame(const std::vector<float>& decibels, float negativeInfinity);
+
+    void paint(juce::Graphics& g) override;
+
+    void resized() override;
+private:
+    static constexpr int NumColours = 256;
+    std::array<juce::PixelARGB, NumColours> colourLut;
+
+    juce::Image ring;
+    int writeColumn { 0 };
+    // each row's position on the log frequency axis, 0 at 20 Hz and 1 at 20 kHz
+    std::vector<float> rowPositions;
+};
+
+/*
+ Input and output peak / RMS bars and loudness, read from the processor's meters. The
+ processor only measures while one of these is on screen.
+ */
+struct MeterComponent : juce::Component, juce::Timer
+{
+    MeterComponent(EqualizerAudioProcessor&);
+    ~MeterComponent() override;
+
+    void timerCallback() override { repaint(); }
+
+    void paint(juce::Graphics& g) override;
+private:
+    EqualizerAudioProcessor& audioProcessor;
+};
+
+/*
+ The response curve's grid labels, shaped once for every editor in the process rather than on
+ every resize. Each label is laid out with its top left corner at the origin and only moved
+ into place when it's drawn.
+ */
+struct ResponseGridLabels
+{
+    ResponseGridLabels();
+
+    static constexpr int FontHeight = 10;
+
+    struct Label
+    {
+        float value;
+        juce::GlyphArrangement glyphs;
+        int width;
+    };
+    // the frequency lines; the gain lines with the response's dB, then the analyzer's dB
+    std::vector<Label> frequencies, gains, analyzerGains;
 };
 
 struct ResponseCurveComponent: juce::Component,
 juce::AudioProcessorParameter::Listener,
 juce::Timer
 {
-    ResponseCurveComponent(EqualizerAudioProcessor&);
+    ResponseCurveComponent(EqualizerAudioProcessor&, SpectrogramComponent&);
     ~ResponseCurveComponent();
     
     void parameterValueChanged (int parameterIndex, float newValue) override;
@@ -236,22 +583,60 @@ juce::Timer
     
 private:
     EqualizerAudioProcessor& audioProcessor;
+    SpectrogramComponent& spectrogram;
+    std::vector<float> spectrogramFrame;
     juce::Atomic<bool> parametersChanged { false };
     
-    MonoChain monoChain;
+    // the biquad cascade the processor runs, designed for its sections only
+    BiquadCascade<double> designCascade;
+    SvfChain<double> designSvfChain;
+    double designSampleRate { 0 };
+    // left/mid and right/side
+    std::array<std::vector<ResponseEvaluator::Section>, 2> laneSections;
+    ResponseEvaluator responseEvaluator;
+    std::vector<double> curveFrequencies;
+    bool lanesDiffer { false };
     void updateChain();
+
+    /*
+     The curves, evaluated in one pass per lane and kept until the parameters, the size, the
+     sample rate or the trace change. The phase or group delay of left/mid comes out of the
+     same pass as its magnitude.
+     */
+    static constexpr double MaxGroupDelayMs = 20.0;
+    void updateResponse();
+    bool responseIsStale { true };
+    ResponseTrace responseTrace { ResponseTrace_None };
+    std::vector<double> mags, secondLaneMags, traceValues;
+    juce::Path responseCurve, secondLaneCurve, traceCurve;
+
+    // the processor's latest self-measurement of left/mid, over the designed curve
+    bool showMeasurement { false };
+    std::vector<double> measuredMags;
+    juce::Path measuredCurve;
+    double measurementDeviation { 0 };
+    // rendered on the first paint after a resize, so opening an editor doesn't wait for it
     juce::Image background;
+    bool backgroundIsStale { true };
+    void renderBackground();
+    juce::SharedResourcePointer<ResponseGridLabels> gridLabels;
     juce::Rectangle<int> getRenderArea();
     juce::Rectangle<int> getAnalysisArea();
-    PathProducer leftPathProducer, rightPathProducer;
+    PathProducer pathProducer;
+    AnalyzerSource analyzerSource { AnalyzerSource_Post };
 };
 
-class EqualizerAudioProcessorEditor  : public juce::AudioProcessorEditor{
+class EqualizerAudioProcessorEditor  : public juce::AudioProcessorEditor,
+juce::AudioProcessorValueTreeState::Listener,
+juce::AsyncUpdater
+{
 public:
     EqualizerAudioProcessorEditor (EqualizerAudioProcessor&);
     ~EqualizerAudioProcessorEditor() override;
     void paint (juce::Graphics&) override;
     void resized() override;
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
 private:
     EqualizerAudioProcessor& audioProcessor;
     RotarySliderWithLabels peakFreqSlider,
@@ -262,6 +647,8 @@ private:
     lowCutSlopeSlider,
     highCutSlopeSlider;
     
+    SpectrogramComponent spectrogramComponent;
+    MeterComponent meterComponent;
     ResponseCurveComponent responseCurveComponent;
     
     using APVTS = juce::AudioProcessorValueTreeState;
@@ -282,8 +669,34 @@ private:
                      highcutBypassButtonAttachment,
                      analyzerEnabledButtonAttachment;
 
+    // store the EQ into the picked slot or recall it from there, and morph between two slots
+    juce::ComboBox snapshotSlotBox, morphFromBox, morphToBox;
+    juce::TextButton storeSnapshotButton { "Store" }, recallSnapshotButton { "Recall" };
+    juce::ToggleButton morphButton { "Morph" };
+    juce::Slider morphAmountSlider { juce::Slider::LinearHorizontal, juce::Slider::NoTextBox };
+    ButtonAttachment morphButtonAttachment;
+    // made once the boxes hold the parameters' choices
+    std::unique_ptr<APVTS::ComboBoxAttachment> morphFromBoxAttachment, morphToBoxAttachment;
+    Attachment morphAmountSliderAttachment;
+    void updateSnapshotButtons();
+
+    /*
+     Every parameter without a knob, in rows under them: how the EQ is processed, the dynamic
+     peak, where the sections sit and what the display shows, and the extra band bandBox picks,
+     whose controls are made again for each band picked. 'Peak Design' is greyed out with the
+     SVF topology, which only has the RBJ bell.
+     */
+    using ParameterControls = std::vector<std::unique_ptr<ParameterControl>>;
+    static constexpr int ControlRowHeight = 40;
+    ParameterControls processingControls, dynamicsControls, displayControls, bandControls;
+    ParameterControl* peakDesignControl { nullptr };
+    juce::ComboBox bandBox;
+    void addControls(ParameterControls& controls, std::initializer_list<std::pair<juce::String, juce::String>> idsAndCaptions);
+    void showBand(int band);
+    static void layOutRow(ParameterControls& controls, juce::Rectangle<int> area);
+
     std::vector<juce::Component*> getComps();
-    LookAndFeel lnf;
+    juce::SharedResourcePointer<LookAndFeel> lnf;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EqualizerAudioProcessorEditor)
 };
@@ -22,10 +22,47 @@ EqualizerAudioProcessor::EqualizerAudioProcessor()
                        )
 #endif
 {
+    for( auto* param : getParameters() )
+        param->addListener(this);
+    parallelChannelsIndex = apvts.getParameter("Parallel Channels")->getParameterIndex();
 }
 
 EqualizerAudioProcessor::~EqualizerAudioProcessor()
 {
+    for( auto* param : getParameters() )
+        param->removeListener(this);
+}
+
+void EqualizerAudioProcessor::parameterValueChanged(int parameterIndex, float newValue)
+{
+    // any parameter may move the response; the auto gain catches up on the next block
+    ++responseVersion;
+
+    // this may be the audio thread; the workers are started and stopped on the message thread
+    if( parameterIndex == parallelChannelsIndex )
+        triggerAsyncUpdate();
+}
+
+void EqualizerAudioProcessor::handleAsyncUpdate()
+{
+    updateGroupPool();
+}
+
+void EqualizerAudioProcessor::updateGroupPool()
+{
+    // the audio thread takes groups too, so a pair of channels needs no workers
+    auto parallel = apvts.getRawParameterValue("Parallel Channels")->load() > 0.5f;
+    auto numGroups = (int) floatChains.size();
+    auto numThreads = groupsPrepared && parallel ? juce::jmin(numGroups - 1, juce::SystemStats::getNumCpus() - 1) : 0;
+    if( numThreads == groupPool.getNumThreads() )
+        return;
+
+    // a block may be handing groups to the workers being replaced
+    const juce::ScopedLock lock(getCallbackLock());
+    if( numThreads > 0 )
+        groupPool.start(numThreads);
+    else
+        groupPool.stop();
 }
 
 //==============================================================================
@@ -63,7 +100,7 @@ bool EqualizerAudioProcessor::isMidiEffect() const
 
 double EqualizerAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLengthSeconds.load();
 }
 
 int EqualizerAudioProcessor::getNumPrograms()
@@ -97,16 +134,39 @@ void EqualizerAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBl
     spec.maximumBlockSize = samplesPerBlock;
     spec.numChannels = 1;
     spec.sampleRate = sampleRate;
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    auto numGroups = juce::jmax(1, (getTotalNumOutputChannels() + 1) / 2);
+    floatChains.resize(numGroups);
+    doubleChains.resize(numGroups);
+    for( auto& chains : floatChains )
+        chains.prepare(spec);
+    for( auto& chains : doubleChains )
+        chains.prepare(spec);
+    groupsPrepared = true;
+    updateGroupPool();
+    prepareAutoGain(sampleRate);
+    morphPosition.reset(sampleRate, MorphSmoothingSeconds);
+    // the stored snapshots' designs were made for the old sample rate
+    publishSnapshots();
+    blockVersion = responseVersion.load();
+    blockSettings = getChainSettings(apvts);
     updateFilters();
-    leftChannelFifo.prepare(samplesPerBlock);
-    rightChannelFifo.prepare(samplesPerBlock);
+    silentSamples = 0;
+    filtersAsleep = false;
+    if( activePrecision == Precision::Precision_Double )
+        updateTailLength(doubleChains.front());
+    else
+        updateTailLength(floatChains.front());
+    doublePrecisionBuffer.setSize(getTotalNumOutputChannels(), samplesPerBlock);
+    inputMeter.prepare(sampleRate);
+    outputMeter.prepare(sampleRate);
+    // room for a few blocks, or for a couple of editor frames at high sample rates
+    analyzerCapture.prepare(juce::jmax(4 * samplesPerBlock, 1 << 15));
     osc.initialise([](float x) { return std::sin(x); });
 
       spec.numChannels = getTotalNumOutputChannels();
       osc.prepare(spec);
       osc.setFrequency(440);
+    measurement.prepare(sampleRate);
 
 }
 
@@ -114,6 +174,8 @@ void EqualizerAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    groupsPrepared = false;
+    groupPool.stop();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -123,12 +185,10 @@ bool EqualizerAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Mono, stereo, or a wider bus of up to MaxChannels, processed as
+    // consecutive channel pairs in the host's channel order.
+    auto numChannels = layouts.getMainOutputChannelSet().size();
+    if (numChannels < 1 || numChannels > MaxChannels)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -150,22 +210,225 @@ void EqualizerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    updateFilters();
+    auto metering = metersActive.load();
+    if( metering )
+        measure(inputMeter, buffer);
+    
+    auto chainSettings = getBlockSettings();
+    updateMorph(chainSettings, buffer.getNumSamples());
+    
+    // the excitation replaces the input; the meters above still show what came in
+    auto measurementSignal = static_cast<MeasurementSignal>(apvts.getRawParameterValue("Measurement")->load());
+    measurement.writeExcitation(buffer, measurementSignal, osc);
     
-    juce::dsp::AudioBlock<float> block(buffer);
+    // decided on the previous block's silence, so that pre and post always come in pairs
+    auto capturing = !analyzerIsIdle();
+    if( capturing )
+        analyzerCapture.writePre(buffer);
+    
+    if( chainSettings.precision == Precision::Precision_Double )
+    {
+        activatePrecision(Precision::Precision_Double);
+        updateFilters(doubleChains, chainSettings);
 
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+        if( !skipSilentBlock(doubleChains, buffer) )
+        {
+            // run the double chains on a converted copy; doublePrecisionBuffer was sized in prepareToPlay
+            auto numChannels = buffer.getNumChannels();
+            auto numSamples = buffer.getNumSamples();
+            doublePrecisionBuffer.setSize(numChannels, numSamples, false, false, true);
+            for( int ch = 0; ch < numChannels; ++ch )
+                std::copy(buffer.getReadPointer(ch), buffer.getReadPointer(ch) + numSamples, doublePrecisionBuffer.getWritePointer(ch));
 
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+            processChains(doubleChains, doublePrecisionBuffer, chainSettings);
+
+            for( int ch = 0; ch < numChannels; ++ch )
+                std::copy(doublePrecisionBuffer.getReadPointer(ch), doublePrecisionBuffer.getReadPointer(ch) + numSamples, buffer.getWritePointer(ch));
+        }
+    }
+    else
+    {
+        activatePrecision(Precision::Precision_Float);
+        updateFilters(floatChains, chainSettings);
+
+        if( !skipSilentBlock(floatChains, buffer) )
+            processChains(floatChains, buffer, chainSettings);
+    }
+    measurement.captureResponse(buffer);
+    
+    if( capturing )
+        analyzerCapture.writePost(buffer);
+    
+    if( metering )
+        measure(outputMeter, buffer);
+}
 
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
-    leftChannelFifo.update(buffer);
-    rightChannelFifo.update(buffer);
+void EqualizerAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    juce::ScopedNoDenormals noDenormals;
+    auto totalNumInputChannels  = getTotalNumInputChannels();
+    auto totalNumOutputChannels = getTotalNumOutputChannels();
+    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+        buffer.clear (i, 0, buffer.getNumSamples());
+    
+    auto metering = metersActive.load();
+    if( metering )
+        measure(inputMeter, buffer);
+    
+    // the host already hands us doubles, so 'Processing Precision' has nothing left to choose
+    auto chainSettings = getBlockSettings();
+    updateMorph(chainSettings, buffer.getNumSamples());
+    activatePrecision(Precision::Precision_Double);
+    updateFilters(doubleChains, chainSettings);
     
+    auto measurementSignal = static_cast<MeasurementSignal>(apvts.getRawParameterValue("Measurement")->load());
+    measurement.writeExcitation(buffer, measurementSignal, osc);
     
+    auto capturing = !analyzerIsIdle();
+    if( capturing )
+        analyzerCapture.writePre(buffer);
+    
+    if( !skipSilentBlock(doubleChains, buffer) )
+        processChains(doubleChains, buffer, chainSettings);
+    measurement.captureResponse(buffer);
+    
+    if( capturing )
+        analyzerCapture.writePost(buffer);
+    
+    if( metering )
+        measure(outputMeter, buffer);
+}
+
+template<typename SampleType>
+void EqualizerAudioProcessor::processChains(ChainGroups<SampleType>& groups, juce::AudioBuffer<SampleType>& buffer, const ChainSettings& chainSettings)
+{
+    const auto numChannels = buffer.getNumChannels();
+    const auto numSamples = buffer.getNumSamples();
+    const auto numGroups = juce::jmin((int) groups.size(), (numChannels + 1) / 2);
+    // taken here, so the workers never touch the buffer itself
+    auto* const* channels = buffer.getArrayOfWritePointers();
+
+    auto process = [&](int group)
+    {
+        // a lone last channel, or a mono bus, goes through both lanes in place
+        auto* left = channels[2 * group];
+        auto* right = channels[juce::jmin(2 * group + 1, numChannels - 1)];
+        processGroup(groups[group], left, right, numSamples, chainSettings);
+    };
+
+    if( chainSettings.parallelChannels && numGroups > 1 && numSamples >= MinParallelSamples && groupPool.getNumThreads() > 0 )
+    {
+        groupPool.run(numGroups, process);
+        return;
+    }
+
+    for( int group = 0; group < numGroups; ++group )
+        process(group);
+}
+
+template<typename SampleType>
+void EqualizerAudioProcessor::processGroup(StereoChains<SampleType>& chains, SampleType* left, SampleType* right, int numSamples, const ChainSettings& chainSettings)
+{
+    auto dynamicPeak = chainSettings.peakDynamic && !chainSettings.peakBypassed;
+    if( !dynamicPeak && !chainSettings.morph )
+    {
+        chains.process(left, right, numSamples);
+        return;
+    }
+
+    for( int start = 0; start < numSamples; start += (int) ControlBlockSize )
+    {
+        auto length = juce::jmin((int) ControlBlockSize, numSamples - start);
+
+        if( chainSettings.morph )
+        {
+            auto amount = morphBlockStart + (morphBlockEnd - morphBlockStart) * double(start) / double(numSamples);
+            MorphEndpoint::blend(morphEndpoints[chainSettings.morphFrom], morphEndpoints[chainSettings.morphTo], amount, chains.cascade);
+        }
+
+        // each group follows its own level
+        if( dynamicPeak )
+        {
+            auto level = chains.peakFollower.process(left + start, right + start, length);
+            chains.setDynamicPeakGain(computeDynamicPeakGain(chainSettings, (float) level));
+        }
+
+        chains.process(left + start, right + start, length);
+    }
+}
+
+template<typename SampleType, typename BufferSampleType>
+bool EqualizerAudioProcessor::skipSilentBlock(ChainGroups<SampleType>& groups, const juce::AudioBuffer<BufferSampleType>& buffer)
+{
+    // every group runs the same filters
+    if( tailVersion != blockVersion || morphBlockStart != morphBlockEnd )
+        updateTailLength(groups.front());
+    
+    // anything but exact zeros may be a quiet signal, or a noise floor someone wants kept
+    const auto numSamples = buffer.getNumSamples();
+    auto silent = true;
+    for( int ch = 0; ch < buffer.getNumChannels() && silent; ++ch )
+        silent = buffer.getMagnitude(ch, 0, numSamples) == (BufferSampleType) 0;
+    
+    if( !silent )
+    {
+        silentSamples = 0;
+        filtersAsleep = false;
+        return false;
+    }
+    
+    // the input went quiet 'silentSamples' ago; until the filters have rung out they still have output to give
+    auto rungOut = silentSamples >= tailSamples;
+    silentSamples += numSamples;
+    
+    if( !rungOut )
+        return false;
+    
+    // what's left in the state has decayed below TailDecay; clear it so waking up starts clean
+    if( !filtersAsleep )
+    {
+        for( auto& chains : groups )
+            chains.reset();
+        filtersAsleep = true;
+    }
+    return true;
+}
+
+template<typename SampleType>
+void EqualizerAudioProcessor::updateTailLength(StereoChains<SampleType>& chains)
+{
+    tailSamples = chains.getTailSamples((SampleType) TailDecay);
+    tailLengthSeconds.store(tailSamples / getSampleRate());
+    tailVersion = blockVersion;
+}
+
+template<typename SampleType>
+void EqualizerAudioProcessor::measure(LoudnessMeter& meter, const juce::AudioBuffer<SampleType>& buffer)
+{
+    // a mono bus is measured as the same signal on both sides
+    auto right = juce::jmin(1, buffer.getNumChannels() - 1);
+    meter.process(buffer.getReadPointer(0), buffer.getReadPointer(right), buffer.getNumSamples());
+}
+
+void EqualizerAudioProcessor::activatePrecision(Precision precision)
+{
+    // the chains of the other precision stopped running at some earlier block
+    if( precision == activePrecision )
+        return;
+
+    if( precision == Precision::Precision_Double )
+    {
+        for( auto& chains : doubleChains )
+            chains.reset();
+    }
+    else
+    {
+        for( auto& chains : floatChains )
+            chains.reset();
+    }
+
+    activePrecision = precision;
+    tailVersion = -1;
 }
 
 //==============================================================================
@@ -181,85 +444,811 @@ juce::AudioProcessorEditor* EqualizerAudioProcessor::createEditor()
 }
 
 //==============================================================================
+static juce::uint32 fnv1a(const void* data, size_t size)
+{
+    juce::uint32 hash = 2166136261u;
+    auto* bytes = static_cast<const juce::uint8*>(data);
+    for( size_t i = 0; i < size; ++i )
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
 void EqualizerAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
     // You should use this method to store your parameters in the memory block.
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
-    juce::MemoryOutputStream mos(destData, true);
-    apvts.state.writeToStream(mos);
+    const auto& parameters = getParameters();
+    juce::MemoryOutputStream mos;
+    mos.writeInt((int) StateMagic);
+    mos.writeShort((short) StateVersion);
+    // a measurement is a one-off action, not part of the session
+    auto* measurementParam = apvts.getParameter("Measurement");
+    mos.writeShort((short) (parameters.size() - 1));
+    for( auto* param : parameters )
+    {
+        if( param == measurementParam )
+            continue;
+        mos.writeString(getParameterID(param));
+        mos.writeFloat(param->getValue());
+    }
+    writeSnapshots(mos);
+    mos.writeInt((int) fnv1a(mos.getData(), mos.getDataSize()));
+
+    destData.append(mos.getData(), mos.getDataSize());
 }
 
 void EqualizerAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
+
+    // from here until the new settings are handed over, the audio thread holds on to its last ones
+    ++pendingRecalls;
+    if( !restoreBinaryState(data, sizeInBytes) && !restoreValueTreeState(data, sizeInBytes) )
+    {
+        --pendingRecalls;
+        return;
+    }
+
+    // the whole load is one change to the host, not one per parameter it touched
+    updateHostDisplay();
+    handOverRecall();
+}
+
+// pendingRecalls was raised before the parameters were written
+void EqualizerAudioProcessor::handOverRecall()
+{
+    auto chainSettings = getChainSettings(apvts);
+    auto sampleRate = getSampleRate();
+    if( sampleRate > 0 )
+    {
+        auto& cache = CoefficientCache::getInstance();
+        cache.getLowCut(chainSettings, sampleRate);
+        cache.getHighCut(chainSettings, sampleRate);
+        cache.getPeak(chainSettings, sampleRate);
+    }
+
+    // with the queue full, the parameters alone are already the whole new state
+    if( !recalledSettings.push(chainSettings) )
+        --pendingRecalls;
+}
+
+juce::String EqualizerAudioProcessor::getParameterID(const juce::AudioProcessorParameter* param)
+{
+    if( auto* withID = dynamic_cast<const juce::AudioProcessorParameterWithID*>(param) )
+        return withID->paramID;
+    return {};
+}
+
+bool EqualizerAudioProcessor::restoreBinaryState(const void* data, int sizeInBytes)
+{
+    const auto headerSize = 8, checksumSize = 4;
+    if( sizeInBytes < headerSize + checksumSize )
+        return false;
+
+    auto checksum = juce::ByteOrder::littleEndianInt(static_cast<const char*>(data) + sizeInBytes - checksumSize);
+    if( checksum != fnv1a(data, (size_t) (sizeInBytes - checksumSize)) )
+        return false;
+
+    // a block from a later build, with a version this one doesn't know, isn't read at all
+    juce::MemoryInputStream mis(data, (size_t) (sizeInBytes - checksumSize), false);
+    if( (juce::uint32) mis.readInt() != StateMagic || mis.readShort() != StateVersion )
+        return false;
+
+    auto entries = readEntries(mis);
+    std::array<std::pair<bool, std::vector<StateEntry>>, NumSnapshots> snapshotEntries;
+    if( mis.readShort() != NumSnapshots )
+        return false;
+    for( auto& [stored, slotEntries] : snapshotEntries )
+    {
+        stored = mis.readBool();
+        if( stored )
+            slotEntries = readEntries(mis);
+    }
+    if( mis.getPosition() != mis.getTotalLength() )
+        return false;
+
+    auto values = matchEntries(entries);
+    juce::ValueTree state(apvts.state.getType());
+    const auto& parameters = getParameters();
+    for( int i = 0; i < parameters.size(); ++i )
+    {
+        auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameters[i]);
+        if( ranged == nullptr )
+            continue;
+
+        juce::ValueTree child("PARAM");
+        child.setProperty("id", ranged->paramID, nullptr);
+        child.setProperty("value", ranged->convertFrom0to1(values[(size_t) i]), nullptr);
+        state.appendChild(child, nullptr);
+    }
+    apvts.replaceState(state);
+
+    for( int slot = 0; slot < NumSnapshots; ++slot )
+    {
+        auto& snapshot = snapshots[slot];
+        snapshot.stored = snapshotEntries[slot].first;
+        if( snapshot.stored )
+        {
+            snapshot.values = matchEntries(snapshotEntries[slot].second);
+            snapshot.chainSettings = getSnapshotSettings(snapshot.values);
+        }
+    }
+    publishSnapshots();
+    return true;
+}
+
+std::vector<EqualizerAudioProcessor::StateEntry> EqualizerAudioProcessor::readEntries(juce::InputStream& in)
+{
+    std::vector<StateEntry> entries((size_t) juce::jmax(0, (int) in.readShort()));
+    for( auto& entry : entries )
+    {
+        entry.id = in.readString();
+        entry.value = in.readFloat();
+    }
+    return entries;
+}
+
+// normalised values in parameter order, at their defaults where the entries don't have them
+std::vector<float> EqualizerAudioProcessor::matchEntries(const std::vector<StateEntry>& entries)
+{
+    std::vector<float> values;
+    // saved by this build, the entries come in parameter order, so the next one is nearly always the match
+    size_t next = 0;
+    for( auto* param : getParameters() )
+    {
+        auto id = getParameterID(param);
+        auto value = param->getDefaultValue();
+        if( next < entries.size() && entries[next].id == id )
+        {
+            value = entries[next++].value;
+        }
+        else
+        {
+            for( size_t e = 0; e < entries.size(); ++e )
+            {
+                if( entries[e].id == id )
+                {
+                    value = entries[e].value;
+                    next = e + 1;
+                    break;
+                }
+            }
+        }
+        values.push_back(juce::jlimit(0.f, 1.f, value));
+    }
+    return values;
+}
+
+// after the parameters: NumSnapshots, then for each slot whether it is stored and, if so, its entries
+void EqualizerAudioProcessor::writeSnapshots(juce::OutputStream& out) const
+{
+    const auto& parameters = getParameters();
+    out.writeShort((short) NumSnapshots);
+    for( const auto& snapshot : snapshots )
+    {
+        out.writeBool(snapshot.stored);
+        if( !snapshot.stored )
+            continue;
+
+        std::vector<int> indices;
+        for( int i = 0; i < parameters.size(); ++i )
+        {
+            if( belongsToSnapshot(getParameterID(parameters[i])) )
+                indices.push_back(i);
+        }
+        out.writeShort((short) indices.size());
+        for( auto i : indices )
+        {
+            out.writeString(getParameterID(parameters[i]));
+            out.writeFloat(snapshot.values[(size_t) i]);
+        }
+    }
+}
+
+// the format every state was saved in before the binary block
+bool EqualizerAudioProcessor::restoreValueTreeState(const void* data, int sizeInBytes)
+{
     auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
-    if (tree.isValid()) {
-        apvts.replaceState(tree);
-        updateFilters();
+    if( !tree.isValid() )
+        return false;
+
+    // a measurement is never part of a session
+    auto measurement = tree.getChildWithProperty("id", "Measurement");
+    if( measurement.isValid() )
+        measurement.setProperty("value", (int) MeasurementSignal_Off, nullptr);
+
+    apvts.replaceState(tree);
+    // the snapshots came with the binary block
+    for( auto& snapshot : snapshots )
+        snapshot.stored = false;
+    publishSnapshots();
+    return true;
+}
+
+ChainSettings EqualizerAudioProcessor::getBlockSettings()
+{
+    // read before the settings, so a change made meanwhile still counts as new next block
+    blockVersion = responseVersion.load();
+
+    ChainSettings recalled;
+    auto numRecalled = 0;
+    while( recalledSettings.pull(recalled) )
+        ++numRecalled;
+
+    if( numRecalled > 0 )
+    {
+        blockSettings = recalled;
+        pendingRecalls -= numRecalled;
+        tailVersion = -1;
     }
+    else if( pendingRecalls.load() == 0 )
+    {
+        // a recall starting while the parameters are read could have torn them; checking on both sides catches it
+        auto chainSettings = getChainSettings(apvts);
+        if( pendingRecalls.load() == 0 )
+            blockSettings = chainSettings;
+    }
+
+    return withMorph(withMeasurement(blockSettings));
 }
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+// a measurement is held against the designed response, so nothing that moves away from it runs meanwhile
+ChainSettings EqualizerAudioProcessor::withMeasurement(ChainSettings chainSettings)
+{
+    if( apvts.getRawParameterValue("Measurement")->load() != (float) MeasurementSignal_Off )
+    {
+        chainSettings.morph = false;
+        chainSettings.peakDynamic = false;
+        chainSettings.autoGain = false;
+    }
+    return chainSettings;
+}
+
+ChainSettings EqualizerAudioProcessor::withMorph(ChainSettings chainSettings)
+{
+    // until both ends hold a snapshot there is nothing to morph between
+    auto stored = storedSnapshots.load();
+    if( (stored & (1 << chainSettings.morphFrom)) == 0 || (stored & (1 << chainSettings.morphTo)) == 0 )
+        chainSettings.morph = false;
+
+    if( chainSettings.morph )
+    {
+        chainSettings.topology = Topology::Topology_Biquad;
+        chainSettings.peakDynamic = false;
+    }
+    return chainSettings;
+}
+
+void EqualizerAudioProcessor::storeSnapshot(int slot)
+{
+    jassert(juce::isPositiveAndBelow(slot, NumSnapshots));
+    auto& snapshot = snapshots[slot];
+    snapshot.values.clear();
+    for( auto* param : getParameters() )
+        snapshot.values.push_back(param->getValue());
+    snapshot.chainSettings = getChainSettings(apvts);
+    snapshot.stored = true;
+    publishSnapshot(slot);
+}
+
+// a snapshot is the EQ itself, not how it is processed, shown or measured; the morph controls pick between snapshots
+bool EqualizerAudioProcessor::belongsToSnapshot(const juce::String& id)
+{
+    static const juce::StringArray utilityIDs { "Processing Precision", "Parallel Channels", "Analyzer Enabled",
+                                                "Analyzer Source", "Analyzer Display", "Response Trace", "Measurement" };
+    return !id.startsWith("Morph") && !utilityIDs.contains(id);
+}
+
+void EqualizerAudioProcessor::recallSnapshot(int slot)
+{
+    jassert(juce::isPositiveAndBelow(slot, NumSnapshots));
+    const auto& snapshot = snapshots[slot];
+    const auto& parameters = getParameters();
+    if( !snapshot.stored || (int) snapshot.values.size() != parameters.size() )
+        return;
+
+    ++pendingRecalls;
+    for( int i = 0; i < parameters.size(); ++i )
+    {
+        if( belongsToSnapshot(getParameterID(parameters[i])) )
+            parameters[i]->setValueNotifyingHost(snapshot.values[(size_t) i]);
+    }
+    handOverRecall();
+}
+
+void EqualizerAudioProcessor::publishSnapshot(int slot)
+{
+    auto sampleRate = getSampleRate();
+    if( sampleRate > 0 )
+    {
+        MorphUpdate update;
+        update.slot = slot;
+        update.endpoint.design(snapshots[slot].chainSettings, sampleRate);
+        // 30 stores without a single block in between; prepareToPlay publishes them all again
+        auto pushed = morphUpdates.push(update);
+        jassert(pushed);
+        juce::ignoreUnused(pushed);
+    }
+
+    // after the push, so a block that sees the slot stored also pulls its design
+    storedSnapshots |= 1 << slot;
+}
+
+void EqualizerAudioProcessor::publishSnapshots()
+{
+    storedSnapshots = 0;
+    for( int slot = 0; slot < NumSnapshots; ++slot )
+    {
+        if( snapshots[slot].stored )
+            publishSnapshot(slot);
+    }
+}
+
+void EqualizerAudioProcessor::updateMorph(const ChainSettings& chainSettings, int numSamples)
+{
+    MorphUpdate update;
+    while( morphUpdates.pull(update) )
+    {
+        morphEndpoints[update.slot] = update.endpoint;
+        morphAutoGainAmount = -1;
+        tailVersion = -1;
+    }
+
+    if( !chainSettings.morph )
+    {
+        morphPosition.setCurrentAndTargetValue(chainSettings.morphAmount);
+        morphBlockStart = morphBlockEnd = chainSettings.morphAmount;
+        morphAutoGainAmount = -1;
+        return;
+    }
+
+    morphPosition.setTargetValue(chainSettings.morphAmount);
+    morphBlockStart = morphPosition.getCurrentValue();
+    morphPosition.skip(numSamples);
+    morphBlockEnd = morphPosition.getCurrentValue();
+
+    // the auto gain follows the blend the block ends on, not the parameters' own response
+    auto slots = chainSettings.morphFrom * NumSnapshots + chainSettings.morphTo;
+    if( !chainSettings.autoGain || autoGainPoints.empty() || (morphBlockEnd == morphAutoGainAmount && slots == morphAutoGainSlots) )
+        return;
+
+    morphAutoGainAmount = morphBlockEnd;
+    morphAutoGainSlots = slots;
+    MorphEndpoint::blend(morphEndpoints[chainSettings.morphFrom], morphEndpoints[chainSettings.morphTo], morphBlockEnd, morphGainCascade);
+    for( int lane = 0; lane < 2; ++lane )
+        morphAutoGains[lane] = getAutoGain(morphGainCascade, lane);
+}
+
+void MorphEndpoint::design(const ChainSettings &chainSettings, double sampleRate){
+    auto settings = chainSettings;
+    settings.topology = Topology::Topology_Biquad;
+
+    BiquadCascade<double> cascade;
+    cascade.prepare(sampleRate);
+    updateCascade(cascade, settings, sampleRate);
+
+    for( int index = 0; index < NumSections; ++index )
+    {
+        for( int lane = 0; lane < BiquadCascade<double>::Lanes; ++lane )
+        {
+            auto c = cascade.getSectionCoefficients(index, lane);
+            auto& l = sections[index][lane];
+            l.on = cascade.isSectionOn(index, lane);
+            l.b0 = c[0];
+            l.b1 = c[1];
+            l.b2 = c[2];
+            l.k1 = c[3] / (1.0 + c[4]);
+            l.k2 = c[4];
+        }
+    }
+}
+
+struct BandParameterIDs
+{
+    juce::String enabled, type, freq, gain, quality, channel;
+};
+
+// built once, so reading the bands doesn't create strings on the audio thread
+static const std::array<BandParameterIDs, MaxBands>& getBandParameterIDs()
+{
+    static const auto ids = []
+    {
+        std::array<BandParameterIDs, MaxBands> result;
+        for( int b = 0; b < MaxBands; ++b )
+        {
+            auto prefix = "Band " + juce::String(b + 1) + " ";
+            result[b] = { prefix + "Enabled", prefix + "Type", prefix + "Freq", prefix + "Gain", prefix + "Quality", prefix + "Channel" };
+        }
+        return result;
+    }();
+    return ids;
+}
+
+template<typename ReadValue>
+static ChainSettings readChainSettings(ReadValue read)
 {
     ChainSettings settings;
-    settings.lowCutFreq = apvts.getRawParameterValue("LowCut Freq")->load();
-    settings.highCutFreq = apvts.getRawParameterValue("HighCut Freq")->load();
-    settings.peakFreq = apvts.getRawParameterValue("Peak Freq")->load();
-    settings.peakGainInDecibels = apvts.getRawParameterValue("Peak Gain")->load();
-    settings.peakQuality = apvts.getRawParameterValue("Peak Quality")->load();
-    settings.lowCutSlope = static_cast<Slope>(apvts.getRawParameterValue("LowCut Slope")->load());
-     settings.highCutSlope = static_cast<Slope>(apvts.getRawParameterValue("HighCut Slope")->load());
-    settings.lowCutBypassed = apvts.getRawParameterValue("LowCut Bypassed")->load() > 0.5f;
-       settings.peakBypassed = apvts.getRawParameterValue("Peak Bypassed")->load() > 0.5f;
-       settings.highCutBypassed = apvts.getRawParameterValue("HighCut Bypassed")->load() > 0.5f;
+    settings.lowCutFreq = read("LowCut Freq");
+    settings.highCutFreq = read("HighCut Freq");
+    settings.peakFreq = read("Peak Freq");
+    settings.peakGainInDecibels = read("Peak Gain");
+    settings.peakQuality = read("Peak Quality");
+    settings.lowCutSlope = static_cast<Slope>(read("LowCut Slope"));
+     settings.highCutSlope = static_cast<Slope>(read("HighCut Slope"));
+    settings.lowCutBypassed = read("LowCut Bypassed") > 0.5f;
+       settings.peakBypassed = read("Peak Bypassed") > 0.5f;
+       settings.highCutBypassed = read("HighCut Bypassed") > 0.5f;
+    settings.peakDesign = static_cast<PeakDesign>(read("Peak Design"));
+    settings.topology = static_cast<Topology>(read("Filter Topology"));
+    // the SVF's bell is the bilinear one
+    if( settings.topology == Topology::Topology_SVF )
+        settings.peakDesign = PeakDesign::PeakDesign_RBJ;
+    settings.precision = static_cast<Precision>(read("Processing Precision"));
+    settings.parallelChannels = read("Parallel Channels") > 0.5f;
+    settings.peakDynamic = read("Peak Dynamic") > 0.5f;
+    settings.autoGain = read("Auto Gain") > 0.5f;
+    settings.peakThreshold = read("Peak Threshold");
+    settings.peakRatio = read("Peak Ratio");
+    settings.peakAttack = read("Peak Attack");
+    settings.peakRelease = read("Peak Release");
+    settings.stereoMode = static_cast<StereoMode>(read("Stereo Mode"));
+    settings.lowCutPlacement = static_cast<StereoPlacement>(read("LowCut Channel"));
+    settings.peakPlacement = static_cast<StereoPlacement>(read("Peak Channel"));
+    settings.highCutPlacement = static_cast<StereoPlacement>(read("HighCut Channel"));
+    settings.morph = read("Morph") > 0.5f;
+    settings.morphFrom = static_cast<int>(read("Morph From"));
+    settings.morphTo = static_cast<int>(read("Morph To"));
+    settings.morphAmount = read("Morph Amount");
+    
+    const auto& bandIDs = getBandParameterIDs();
+    for( int b = 0; b < MaxBands; ++b )
+    {
+        auto& band = settings.bands[b];
+        band.enabled = read(bandIDs[b].enabled) > 0.5f;
+        band.type = static_cast<BandType>(read(bandIDs[b].type));
+        band.freq = read(bandIDs[b].freq);
+        band.gainInDecibels = read(bandIDs[b].gain);
+        band.quality = read(bandIDs[b].quality);
+        band.placement = static_cast<StereoPlacement>(read(bandIDs[b].channel));
+    }
     return settings;
 }
 
-Coefficients makePeakFilter(const ChainSettings &chainSettings, double sampleRate){
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,                                                     chainSettings.peakFreq, chainSettings.peakQuality,                                        juce::Decibels::decibelsToGain(chainSettings.peakGainInDecibels));
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+{
+    return readChainSettings([&apvts](const juce::String& id) { return apvts.getRawParameterValue(id)->load(); });
 }
 
-void EqualizerAudioProcessor::updatePeakFilter(const ChainSettings &chainSettings){
-    auto peakCoefficients = makePeakFilter(chainSettings, getSampleRate());
-    leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-        rightChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    updateCoefficients(leftChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+ChainSettings EqualizerAudioProcessor::getSnapshotSettings(const std::vector<float>& values)
+{
+    return readChainSettings([this, &values](const juce::String& id)
+    {
+        auto* param = apvts.getParameter(id);
+        return param->convertFrom0to1(values[(size_t) param->getParameterIndex()]);
+    });
+}
 
+template<typename SampleType>
+typename juce::dsp::IIR::Coefficients<SampleType>::Ptr makePeakFilter(const ChainSettings &chainSettings, double sampleRate){
+    if( chainSettings.peakDesign == PeakDesign::PeakDesign_Matched )
+        return makeMatchedPeakFilter<SampleType>(chainSettings, sampleRate);
+    return juce::dsp::IIR::Coefficients<SampleType>::makePeakFilter(sampleRate,                                                     chainSettings.peakFreq, chainSettings.peakQuality,                                        juce::Decibels::decibelsToGain((SampleType) chainSettings.peakGainInDecibels));
 }
 
-void updateCoefficients(Coefficients &old, const Coefficients &replacements){
-    
-    *old = *replacements;
+template juce::dsp::IIR::Coefficients<float>::Ptr makePeakFilter<float>(const ChainSettings&, double);
+template juce::dsp::IIR::Coefficients<double>::Ptr makePeakFilter<double>(const ChainSettings&, double);
+
+/*
+ Magnitude-matched peak filter after Vicanek, "Matched Second Order Digital Filters" (2016).
+ The poles come from the impulse-invariant mapping of the analog prototype used by the RBJ
+ design, the zeros are solved so the magnitude equals the analog one at DC, at the centre
+ frequency, and has zero slope there. Unlike the bilinear design this doesn't cramp the bell
+ towards Nyquist, so high peaks keep their analog width without oversampling.
+ */
+template<typename SampleType>
+typename juce::dsp::IIR::Coefficients<SampleType>::Ptr makeMatchedPeakFilter(const ChainSettings &chainSettings, double sampleRate){
+    using namespace juce;
+    const auto gain = Decibels::decibelsToGain((double) chainSettings.peakGainInDecibels);
+    const auto w0 = jmin(MathConstants<double>::twoPi * chainSettings.peakFreq / sampleRate,
+                         MathConstants<double>::pi * 0.999);
+    const auto zeta = 1.0 / (2.0 * chainSettings.peakQuality * std::sqrt(gain));
+
+    const auto a2 = std::exp(-2.0 * zeta * w0);
+    const auto a1 = zeta <= 1.0 ? -2.0 * std::exp(-zeta * w0) * std::cos(std::sqrt(1.0 - zeta * zeta) * w0)
+                                : -2.0 * std::exp(-zeta * w0) * std::cosh(std::sqrt(zeta * zeta - 1.0) * w0);
+
+    const auto A0 = (1.0 + a1 + a2) * (1.0 + a1 + a2);
+    const auto A1 = (1.0 - a1 + a2) * (1.0 - a1 + a2);
+    const auto A2 = -4.0 * a2;
+
+    auto phi1 = std::sin(w0 * 0.5);
+    phi1 *= phi1;
+    const auto phi0 = 1.0 - phi1;
+    const auto phi2 = 4.0 * phi0 * phi1;
+
+    const auto gainSquared = gain * gain;
+    const auto B0 = A0;
+    const auto R1 = (A0 * phi0 + A1 * phi1 + A2 * phi2) * gainSquared;
+    const auto R2 = (-A0 + A1 + 4.0 * (phi0 - phi1) * A2) * gainSquared;
+    const auto B2 = (R1 - R2 * phi1 - B0) / (4.0 * phi1 * phi1);
+    const auto B1 = R2 + B0 + 4.0 * (phi1 - phi0) * B2;
+
+    const auto rootB0 = std::sqrt(B0);
+    const auto rootB1 = std::sqrt(jmax(0.0, B1));
+    const auto W = 0.5 * (rootB0 + rootB1);
+    const auto b0 = 0.5 * (W + std::sqrt(jmax(0.0, W * W + B2)));
+    const auto b1 = 0.5 * (rootB0 - rootB1);
+    const auto b2 = -B2 / (4.0 * b0);
+
+    return new dsp::IIR::Coefficients<SampleType>((SampleType) b0, (SampleType) b1, (SampleType) b2,
+                                                  (SampleType) 1, (SampleType) a1, (SampleType) a2);
+}
+
+template juce::dsp::IIR::Coefficients<float>::Ptr makeMatchedPeakFilter<float>(const ChainSettings&, double);
+template juce::dsp::IIR::Coefficients<double>::Ptr makeMatchedPeakFilter<double>(const ChainSettings&, double);
+
+CoefficientCache& CoefficientCache::getInstance(){
+    static CoefficientCache cache;
+    return cache;
+}
+
+CoefficientCache::Design CoefficientCache::getLowCut(const ChainSettings &chainSettings, double sampleRate){
+    return get(Kind_LowCut, chainSettings.lowCutSlope, chainSettings.lowCutFreq, 0.f, 0.f, sampleRate);
+}
+
+CoefficientCache::Design CoefficientCache::getHighCut(const ChainSettings &chainSettings, double sampleRate){
+    return get(Kind_HighCut, chainSettings.highCutSlope, chainSettings.highCutFreq, 0.f, 0.f, sampleRate);
+}
+
+CoefficientCache::Design CoefficientCache::getPeak(const ChainSettings &chainSettings, double sampleRate){
+    auto kind = chainSettings.peakDesign == PeakDesign::PeakDesign_Matched ? Kind_PeakMatched : Kind_PeakRBJ;
+    return get(kind, 0, chainSettings.peakFreq, chainSettings.peakGainInDecibels, chainSettings.peakQuality, sampleRate);
+}
+
+CoefficientCache::Design CoefficientCache::get(Kind kind, int slope, float freq, float gainInDecibels, float quality, double sampleRate){
+    // the parameters' own steps: 1 Hz, 0.5 dB, 0.05
+    auto freqStep = juce::jlimit(0, (1 << 24) - 1, juce::roundToInt(freq));
+    auto gainStep = juce::jlimit(0, 0xffff, juce::roundToInt(gainInDecibels * 2.f) + 0x8000);
+    auto qualityStep = juce::jlimit(0, 0xffff, juce::roundToInt(quality * 20.f));
+
+    // never 0, which marks an empty entry
+    auto filter = juce::uint64(kind) << 60 | juce::uint64(slope) << 56 | juce::uint64(freqStep) << 32
+                | juce::uint64(gainStep) << 16 | juce::uint64(qualityStep);
+    juce::uint64 rate;
+    std::memcpy(&rate, &sampleRate, sizeof(rate));
+
+    auto hash = (filter ^ (rate * 0x9e3779b97f4a7c15ull)) * 0xff51afd7ed558ccdull;
+    auto* set = &entries[size_t((hash >> 32) % NumSets) * Ways];
+
+    Design design;
+    if( find(set, rate, filter, design) )
+        return design;
+
+    ChainSettings settings;
+    settings.lowCutFreq = settings.highCutFreq = settings.peakFreq = float(freqStep);
+    settings.lowCutSlope = settings.highCutSlope = static_cast<Slope>(slope);
+    settings.peakGainInDecibels = float(gainStep - 0x8000) * 0.5f;
+    settings.peakQuality = float(qualityStep) / 20.f;
+    settings.peakDesign = kind == Kind_PeakMatched ? PeakDesign::PeakDesign_Matched : PeakDesign::PeakDesign_RBJ;
+
+    auto copySection = [&design](const juce::dsp::IIR::Coefficients<double>::Ptr& coefficients)
+    {
+        jassert(coefficients->coefficients.size() == 5);
+        std::copy(coefficients->coefficients.begin(), coefficients->coefficients.end(), design.sections[design.numSections++].begin());
+    };
+
+    if( kind == Kind_LowCut || kind == Kind_HighCut )
+    {
+        auto cut = kind == Kind_LowCut ? makeLowCutFilter<double>(settings, sampleRate) : makeHighCutFilter<double>(settings, sampleRate);
+        for( int s = 0; s < juce::jmin(cut.size(), MaxSections); ++s )
+            copySection(cut[s]);
+    }
+    else
+    {
+        copySection(makePeakFilter<double>(settings, sampleRate));
+    }
+
+    store(set, rate, filter, design);
+    return design;
+}
+
+bool CoefficientCache::find(Entry* set, juce::uint64 sampleRate, juce::uint64 filter, Design &design){
+    for( int way = 0; way < Ways; ++way )
+    {
+        auto& entry = set[way];
+        auto sequence = entry.sequence.load(std::memory_order_acquire);
+        if( (sequence & 1) != 0
+           || entry.filter.load(std::memory_order_relaxed) != filter
+           || entry.sampleRate.load(std::memory_order_relaxed) != sampleRate )
+            continue;
+
+        design.numSections = entry.numSections.load(std::memory_order_relaxed);
+        for( int i = 0; i < MaxSections * 5; ++i )
+            design.sections[i / 5][i % 5] = entry.raw[i].load(std::memory_order_relaxed);
+
+        // rewritten while it was being copied: as good as not there
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if( entry.sequence.load(std::memory_order_relaxed) != sequence )
+            continue;
+
+        entry.lastUse.store(++useCounter, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void CoefficientCache::store(Entry* set, juce::uint64 sampleRate, juce::uint64 filter, const Design &design){
+    auto* victim = set;
+    for( int way = 1; way < Ways; ++way )
+    {
+        if( set[way].lastUse.load(std::memory_order_relaxed) < victim->lastUse.load(std::memory_order_relaxed) )
+            victim = &set[way];
+    }
+
+    auto sequence = victim->sequence.load(std::memory_order_relaxed);
+    if( (sequence & 1) != 0 || !victim->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_relaxed) )
+        return;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    victim->sampleRate.store(sampleRate, std::memory_order_relaxed);
+    victim->filter.store(filter, std::memory_order_relaxed);
+    victim->numSections.store(design.numSections, std::memory_order_relaxed);
+    for( int i = 0; i < MaxSections * 5; ++i )
+        victim->raw[i].store(design.sections[i / 5][i % 5], std::memory_order_relaxed);
+    victim->lastUse.store(++useCounter, std::memory_order_relaxed);
+
+    victim->sequence.store(sequence + 2, std::memory_order_release);
 }
 
-void EqualizerAudioProcessor::updateLowCutFilters(const ChainSettings &chainSettings){
-    auto cutCoefficients = makeLowCutFilter(chainSettings, getSampleRate());
-        auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-        auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
-    leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-       rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-        updateCutFilter(leftLowCut, cutCoefficients, chainSettings.lowCutSlope);
-        updateCutFilter(rightLowCut, cutCoefficients, chainSettings.lowCutSlope);
+template<typename SampleType>
+void updateCascade(BiquadCascade<SampleType>& cascade, const ChainSettings& chainSettings, double sampleRate){
+    auto biquad = chainSettings.topology == Topology::Topology_Biquad;
+    auto& cache = CoefficientCache::getInstance();
+
+    // a section that won't run isn't even looked up
+    auto lowCutOff = chainSettings.lowCutBypassed || !biquad;
+    cascade.setCutSections(BiquadCascade<SampleType>::LowCut,
+                           lowCutOff ? CoefficientCache::Design {} : cache.getLowCut(chainSettings, sampleRate),
+                           lowCutOff, chainSettings.lowCutPlacement);
+
+    constexpr auto peak = BiquadCascade<SampleType>::Peak;
+    if( chainSettings.peakBypassed || !biquad )
+    {
+        cascade.disableSection(peak);
+    }
+    else
+    {
+        auto design = cache.getPeak(chainSettings, sampleRate);
+        SampleType raw[5];
+        std::copy(design.sections[0].begin(), design.sections[0].end(), raw);
+        cascade.setSection(peak, raw, chainSettings.peakPlacement);
+    }
+
+    auto highCutOff = chainSettings.highCutBypassed || !biquad;
+    cascade.setCutSections(BiquadCascade<SampleType>::HighCut,
+                           highCutOff ? CoefficientCache::Design {} : cache.getHighCut(chainSettings, sampleRate),
+                           highCutOff, chainSettings.highCutPlacement);
+
+    cascade.updateBands(chainSettings.bands);
 }
 
-void EqualizerAudioProcessor::updateHighCutFilters(const ChainSettings &chainSettings){
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
-        auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-        auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
-    leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-       rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-        updateCutFilter(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
-        updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+template void updateCascade<float>(BiquadCascade<float>&, const ChainSettings&, double);
+template void updateCascade<double>(BiquadCascade<double>&, const ChainSettings&, double);
+
+template<typename SampleType>
+void EqualizerAudioProcessor::updateFilters(StereoChains<SampleType>& chains, const ChainSettings &chainSettings){
+    // the filters as they are now fade out over the ones about to be switched in
+    if( chains.updateStructure(chainSettings) )
+        chains.beginCrossfade();
+
+    // while morphing, processGroup sets the cascade from the snapshots instead
+    if( chainSettings.morph )
+        chains.cascade.invalidateBands();
+    else
+        updateCascade(chains.cascade, chainSettings, getSampleRate());
+    chains.svfChain.update(chainSettings);
+
+    if( chainSettings.peakDynamic )
+    {
+        // the SVF sets its peak gain directly
+        if( chainSettings.topology == Topology::Topology_Biquad )
+            chains.peakGainTable.build(chainSettings, getSampleRate());
+        chains.peakFollower.update(chainSettings);
+    }
+
+    // state built up in another topology or in the other stereo domain is meaningless now
+    if( chainSettings.topology != chains.activeTopology || chainSettings.stereoMode != chains.stereoMode )
+    {
+        chains.resetFilters();
+        chains.activeTopology = chainSettings.topology;
+        chains.stereoMode = chainSettings.stereoMode;
+        chains.autoGainVersion = -1;
+    }
+
+    updateAutoGain(chains, chainSettings);
+}
+
+template<typename SampleType>
+void EqualizerAudioProcessor::updateFilters(ChainGroups<SampleType>& groups, const ChainSettings &chainSettings){
+    for( auto& chains : groups )
+        updateFilters(chains, chainSettings);
+}
+
+void EqualizerAudioProcessor::prepareAutoGain(double sampleRate){
+    autoGainPoints.resize(NumAutoGainPoints);
+    autoGainWeights.resize(NumAutoGainPoints);
+    auto kWeighting = LoudnessMeter::designKWeighting(sampleRate);
+
+    for( int p = 0; p < NumAutoGainPoints; ++p )
+    {
+        auto freq = juce::mapToLog10((p + 0.5) / double(NumAutoGainPoints), 20.0, 20000.0);
+        auto w = juce::MathConstants<double>::twoPi * juce::jmin(freq, sampleRate * 0.49) / sampleRate;
+        auto& point = autoGainPoints[p];
+        point = { std::cos(w), std::cos(2.0 * w), std::tan(w / 2.0) };
+
+        double weight = 1;
+        for( const auto& c : kWeighting )
+        {
+            weight *= (c.b0 * c.b0 + c.b1 * c.b1 + c.b2 * c.b2 + 2.0 * (c.b0 * c.b1 + c.b1 * c.b2) * point.cosW + 2.0 * c.b0 * c.b2 * point.cos2W)
+                    / (1.0 + c.a1 * c.a1 + c.a2 * c.a2 + 2.0 * c.a1 * (1.0 + c.a2) * point.cosW + 2.0 * c.a2 * point.cos2W);
+        }
+        autoGainWeights[p] = weight;
+    }
+
+    for( auto& chains : floatChains )
+        chains.autoGainVersion = -1;
+    for( auto& chains : doubleChains )
+        chains.autoGainVersion = -1;
+    morphAutoGainAmount = -1;
+}
+
+template<typename SampleType>
+void EqualizerAudioProcessor::updateAutoGain(StereoChains<SampleType>& chains, const ChainSettings& chainSettings){
+    auto rampLength = juce::roundToInt(AutoGainRampSeconds * getSampleRate());
+
+    if( !chainSettings.autoGain )
+    {
+        chains.cascade.setOutputGain(SampleType(1), SampleType(1), rampLength);
+        return;
+    }
+
+    // updateMorph has worked it out for the blend; once the morph ends it is recomputed from the parameters
+    if( chainSettings.morph )
+    {
+        chains.cascade.setOutputGain((SampleType) morphAutoGains[0], (SampleType) morphAutoGains[1], rampLength);
+        chains.autoGainVersion = -1;
+        return;
+    }
+
+    auto version = responseVersion.load();
+    if( version == chains.autoGainVersion || autoGainPoints.empty() )
+        return;
+    chains.autoGainVersion = version;
+
+    chains.cascade.setOutputGain((SampleType) getAutoGain(chains, 0), (SampleType) getAutoGain(chains, 1), rampLength);
+}
+
+template<typename Response>
+double EqualizerAudioProcessor::getAutoGain(Response& response, int lane) const
+{
+    double weighted = 0, totalWeight = 0;
+    for( int p = 0; p < NumAutoGainPoints; ++p )
+    {
+        weighted += autoGainWeights[p] * response.getPowerResponse(lane, autoGainPoints[p]);
+        totalWeight += autoGainWeights[p];
+    }
+
+    auto meanPower = juce::jmax(weighted / totalWeight, 1.0e-12);
+    // within the range the gains themselves span
+    return juce::jlimit(juce::Decibels::decibelsToGain(-24.0), juce::Decibels::decibelsToGain(24.0), 1.0 / std::sqrt(meanPower));
 }
 
 void EqualizerAudioProcessor::updateFilters(){
-    auto chainSettings = getChainSettings(apvts);
-    updateLowCutFilters(chainSettings);
-    updatePeakFilter(chainSettings);
-    updateHighCutFilters(chainSettings);
+    auto chainSettings = withMorph(withMeasurement(getChainSettings(apvts)));
+    updateFilters(floatChains, chainSettings);
+    updateFilters(doubleChains, chainSettings);
 }
 juce::AudioProcessorValueTreeState::ParameterLayout EqualizerAudioProcessor::createParameterLayout()
 {
@@ -305,6 +1294,106 @@ juce::AudioProcessorValueTreeState::ParameterLayout EqualizerAudioProcessor::cre
         layout.add(std::make_unique<juce::AudioParameterBool>("Peak Bypassed", "Peak Bypassed", false));
         layout.add(std::make_unique<juce::AudioParameterBool>("HighCut Bypassed", "HighCut Bypassed", false));
         layout.add(std::make_unique<juce::AudioParameterBool>("Analyzer Enabled", "Analyzer Enabled", true));
+    
+    // everything after here came later; appended, so hosts that address parameters by index keep theirs
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Peak Design",
+                                                            "Peak Design",
+                                                            juce::StringArray { "RBJ", "Matched" },
+                                                            0));
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Filter Topology",
+                                                            "Filter Topology",
+                                                            juce::StringArray { "Biquad", "SVF" },
+                                                            0));
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Processing Precision",
+                                                            "Processing Precision",
+                                                            juce::StringArray { "Float", "Double" },
+                                                            0));
+    
+    layout.add(std::make_unique<juce::AudioParameterBool>("Parallel Channels", "Parallel Channels", false));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Threshold",
+                                                           "Peak Threshold",
+                                                           juce::NormalisableRange<float>(-60.f, 0.f, 0.5f, 1.f),
+                                                           -24.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Ratio",
+                                                           "Peak Ratio",
+                                                           juce::NormalisableRange<float>(1.f, 20.f, 0.1f, 0.5f),
+                                                           2.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Attack",
+                                                           "Peak Attack",
+                                                           juce::NormalisableRange<float>(0.1f, 100.f, 0.1f, 0.5f),
+                                                           10.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Release",
+                                                           "Peak Release",
+                                                           juce::NormalisableRange<float>(5.f, 1000.f, 1.f, 0.5f),
+                                                           100.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterBool>("Peak Dynamic", "Peak Dynamic", false));
+    layout.add(std::make_unique<juce::AudioParameterBool>("Auto Gain", "Auto Gain", false));
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Stereo Mode",
+                                                            "Stereo Mode",
+                                                            juce::StringArray { "Left/Right", "Mid/Side" },
+                                                            0));
+    
+    juce::StringArray placements { "Both", "Left/Mid", "Right/Side" };
+    layout.add(std::make_unique<juce::AudioParameterChoice>("LowCut Channel", "LowCut Channel", placements, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Peak Channel", "Peak Channel", placements, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("HighCut Channel", "HighCut Channel", placements, 0));
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Analyzer Source",
+                                                            "Analyzer Source",
+                                                            juce::StringArray { "Post", "Pre/Post", "Difference" },
+                                                            0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Analyzer Display",
+                                                            "Analyzer Display",
+                                                            juce::StringArray { "Left/Right", "Mid/Side", "Sum" },
+                                                            0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Response Trace",
+                                                            "Response Trace",
+                                                            juce::StringArray { "None", "Phase", "Group Delay" },
+                                                            0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Measurement",
+                                                            "Measurement",
+                                                            juce::StringArray { "Off", "Sweep", "MLS" },
+                                                            0));
+    
+    juce::StringArray snapshotSlots { "A", "B", "C", "D" };
+    layout.add(std::make_unique<juce::AudioParameterBool>("Morph", "Morph", false));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Morph From", "Morph From", snapshotSlots, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Morph To", "Morph To", snapshotSlots, 1));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Morph Amount",
+                                                           "Morph Amount",
+                                                           juce::NormalisableRange<float>(0.f, 1.f, 0.001f, 1.f),
+                                                           0.f));
+    
+    const auto& bandIDs = getBandParameterIDs();
+    juce::StringArray bandTypes { "Peak", "Low Shelf", "High Shelf", "Notch", "Tilt" };
+    for( int b = 0; b < MaxBands; ++b )
+    {
+        // spread the default frequencies log-evenly over the audible range
+        auto defaultFreq = juce::mapToLog10((b + 0.5f) / MaxBands, 20.f, 20000.f);
+        layout.add(std::make_unique<juce::AudioParameterBool>(bandIDs[b].enabled, bandIDs[b].enabled, false));
+        layout.add(std::make_unique<juce::AudioParameterChoice>(bandIDs[b].type, bandIDs[b].type, bandTypes, 0));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(bandIDs[b].freq,
+                                                               bandIDs[b].freq,
+                                                               juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
+                                                               std::round(defaultFreq)));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(bandIDs[b].gain,
+                                                               bandIDs[b].gain,
+                                                               juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f),
+                                                               0.0f));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(bandIDs[b].quality,
+                                                               bandIDs[b].quality,
+                                                               juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f),
+                                                               1.f));
+        layout.add(std::make_unique<juce::AudioParameterChoice>(bandIDs[b].channel, bandIDs[b].channel, placements, 0));
+    }
     return layout;
 }
 //==============================================================================
@@ -11,6 +11,8 @@
 #include <JuceHeader.h>
 
 #include <array>
+
+#include "ResponseMeasurement.h"
 template<typename T>
 struct Fifo
 {
@@ -74,75 +76,98 @@ private:
     juce::AbstractFifo fifo {Capacity};
 };
 
-enum Channel
+/*
+ The audio the analyzer looks at: both channels before the EQ and after it, in one lock-free
+ ring. The audio thread publishes all four taps of a block under a single write position, so
+ the reader always gets pre and post samples that line up. When the reader falls behind, the
+ samples that don't fit are dropped rather than waited for.
+ */
+struct AnalyzerCapture
 {
-    Right, //effectively 0
-    Left //effectively 1
-};
+    enum Tap
+    {
+        PreLeft,
+        PreRight,
+        PostLeft,
+        PostRight,
+        NumTaps
+    };
 
-template<typename BlockType>
-struct SingleChannelSampleFifo
-{
-    SingleChannelSampleFifo(Channel ch) : channelToUse(ch)
+    void prepare(int capacity)
     {
-        prepared.set(false);
+        ring.setSize(NumTaps, capacity);
+        ring.clear();
+        fifo.setTotalSize(capacity);
     }
 
-    void update(const BlockType& buffer)
+    // audio thread, before the block is filtered
+    template<typename SampleType>
+    void writePre(const juce::AudioBuffer<SampleType>& buffer)
     {
-        jassert(prepared.get());
-        jassert(buffer.getNumChannels() > channelToUse );
-        auto* channelPtr = buffer.getReadPointer(channelToUse);
-
-        for( int i = 0; i < buffer.getNumSamples(); ++i )
-        {
-            pushNextSampleIntoFifo(channelPtr[i]);
-        }
+        fifo.prepareToWrite(buffer.getNumSamples(), start1, size1, start2, size2);
+        write(buffer, PreLeft);
     }
 
-    void prepare(int bufferSize)
+    // audio thread, after the block is filtered; publishes the pre and post taps together
+    template<typename SampleType>
+    void writePost(const juce::AudioBuffer<SampleType>& buffer)
     {
-        prepared.set(false);
-        size.set(bufferSize);
-
-        bufferToFill.setSize(1,             //channel
-                             bufferSize,    //num samples
-                             false,         //keepExistingContent
-                             true,          //clear extra space
-                             true);         //avoid reallocating
-        audioBufferFifo.prepare(1, bufferSize);
-        fifoIndex = 0;
-        prepared.set(true);
+        write(buffer, PostLeft);
+        fifo.finishedWrite(size1 + size2);
     }
-    //==============================================================================
-    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
-    bool isPrepared() const { return prepared.get(); }
-    int getSize() const { return size.get(); }
-    //==============================================================================
-    bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
-private:
-    Channel channelToUse;
-    int fifoIndex = 0;
-    Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
-    juce::Atomic<bool> prepared = false;
-    juce::Atomic<int> size = 0;
 
-    void pushNextSampleIntoFifo(float sample)
+    /*
+     Shifts everything that is ready onto the end of 'window', which has a channel per tap.
+     Anything older than the window is skipped. Returns the number of new samples.
+     */
+    int read(juce::AudioBuffer<float>& window)
     {
-        if (fifoIndex == bufferToFill.getNumSamples())
+        jassert(window.getNumChannels() == NumTaps);
+        const auto windowSize = window.getNumSamples();
+        auto numReady = fifo.getNumReady();
+        if( numReady > windowSize )
         {
-            auto ok = audioBufferFifo.push(bufferToFill);
+            fifo.finishedRead(numReady - windowSize);
+            numReady = windowSize;
+        }
+
+        if( numReady == 0 )
+            return 0;
 
-            juce::ignoreUnused(ok);
+        int readStart1, readSize1, readStart2, readSize2;
+        fifo.prepareToRead(numReady, readStart1, readSize1, readStart2, readSize2);
+        auto numRead = readSize1 + readSize2;
 
-            fifoIndex = 0;
+        for( int tap = 0; tap < NumTaps; ++tap )
+        {
+            auto* dest = window.getWritePointer(tap);
+            std::copy(dest + numRead, dest + windowSize, dest); // overlapping, so not memcpy
+            dest += windowSize - numRead;
+            juce::FloatVectorOperations::copy(dest, ring.getReadPointer(tap, readStart1), readSize1);
+            juce::FloatVectorOperations::copy(dest + readSize1, ring.getReadPointer(tap, readStart2), readSize2);
         }
 
-        bufferToFill.setSample(0, fifoIndex, sample);
-        ++fifoIndex;
+        fifo.finishedRead(numRead);
+        return numRead;
+    }
+private:
+    template<typename SampleType>
+    void write(const juce::AudioBuffer<SampleType>& buffer, int firstTap)
+    {
+        // a mono bus shows up on both channels
+        for( int ch = 0; ch < 2; ++ch )
+        {
+            auto* source = buffer.getReadPointer(juce::jmin(ch, buffer.getNumChannels() - 1));
+            std::copy(source, source + size1, ring.getWritePointer(firstTap + ch, start1));
+            std::copy(source + size1, source + size1 + size2, ring.getWritePointer(firstTap + ch, start2));
+        }
     }
+
+    juce::AudioBuffer<float> ring;
+    juce::AbstractFifo fifo { 1 };
+    int start1 { 0 }, size1 { 0 }, start2 { 0 }, size2 { 0 };
 };
+
 enum Slope
  {
      Slope_12,
@@ -151,6 +176,93 @@ enum Slope
      Slope_48
  };
 
+enum PeakDesign
+{
+    PeakDesign_RBJ,
+    PeakDesign_Matched
+};
+
+enum Topology
+{
+    Topology_Biquad,
+    Topology_SVF
+};
+
+enum Precision
+{
+    Precision_Float,
+    Precision_Double
+};
+
+enum BandType
+{
+    BandType_Peak,
+    BandType_LowShelf,
+    BandType_HighShelf,
+    BandType_Notch,
+    BandType_Tilt
+};
+
+// which taps the analyzer compares; Difference is post minus pre, on the response curve's scale
+enum AnalyzerSource
+{
+    AnalyzerSource_Post,
+    AnalyzerSource_PrePost,
+    AnalyzerSource_Difference
+};
+
+// what the two analyzer traces show; Sum has only one
+enum AnalyzerDisplay
+{
+    AnalyzerDisplay_LeftRight,
+    AnalyzerDisplay_MidSide,
+    AnalyzerDisplay_Sum
+};
+
+// drawn over the response curve with its own scale
+enum ResponseTrace
+{
+    ResponseTrace_None,
+    ResponseTrace_Phase,
+    ResponseTrace_GroupDelay
+};
+
+enum StereoMode
+{
+    StereoMode_LeftRight,
+    StereoMode_MidSide
+};
+
+// which lane of the stereo pair a section runs on: left/right, or mid/side in mid/side mode
+enum StereoPlacement
+{
+    StereoPlacement_Both,
+    StereoPlacement_LeftMid,
+    StereoPlacement_RightSide
+};
+
+inline bool isOnLane(StereoPlacement placement, int lane)
+{
+    return placement == StereoPlacement_Both || static_cast<int>(placement) == lane + 1;
+}
+
+// extra bands on top of the fixed low cut / peak / high cut
+constexpr int MaxBands = 24;
+
+struct BandSettings
+{
+    float freq { 1000.f }, gainInDecibels { 0 }, quality { 1.f };
+    BandType type { BandType::BandType_Peak };
+    StereoPlacement placement { StereoPlacement::StereoPlacement_Both };
+    bool enabled { false };
+
+    bool operator==(const BandSettings& other) const
+    {
+        return freq == other.freq && gainInDecibels == other.gainInDecibels && quality == other.quality
+            && type == other.type && placement == other.placement && enabled == other.enabled;
+    }
+    bool operator!=(const BandSettings& other) const { return !(*this == other); }
+};
 
 struct ChainSettings
 {
@@ -158,132 +270,1702 @@ struct ChainSettings
     float lowCutFreq { 0 }, highCutFreq { 0 };
     bool lowCutBypassed { false }, peakBypassed { false }, highCutBypassed { false };
     Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };
+    PeakDesign peakDesign { PeakDesign::PeakDesign_RBJ };
+    Topology topology { Topology::Topology_Biquad };
+    Precision precision { Precision::Precision_Float };
+    bool parallelChannels { false };
+    bool peakDynamic { false };
+    bool autoGain { false };
+    float peakThreshold { 0 }, peakRatio { 1.f }, peakAttack { 10.f }, peakRelease { 100.f };
+    std::array<BandSettings, MaxBands> bands;
+    StereoMode stereoMode { StereoMode::StereoMode_LeftRight };
+    StereoPlacement lowCutPlacement { StereoPlacement::StereoPlacement_Both },
+                    peakPlacement { StereoPlacement::StereoPlacement_Both },
+                    highCutPlacement { StereoPlacement::StereoPlacement_Both };
+    bool morph { false };
+    int morphFrom { 0 }, morphTo { 1 };
+    float morphAmount { 0 };
 };
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
 
-using Filter = juce::dsp::IIR::Filter<float>;
-using CutFilter = juce::dsp::ProcessorChain<Filter,Filter,Filter,Filter>;
-using MonoChain = juce::dsp::ProcessorChain<CutFilter,Filter, CutFilter>;
+template<typename SampleType = float>
+typename juce::dsp::IIR::Coefficients<SampleType>::Ptr makePeakFilter(const ChainSettings &chainSettings, double sampleRate);
+template<typename SampleType = float>
+typename juce::dsp::IIR::Coefficients<SampleType>::Ptr makeMatchedPeakFilter(const ChainSettings &chainSettings, double sampleRate);
+
+template<typename SampleType = float>
+inline auto makeLowCutFilter(const ChainSettings &chainSettings, double sampleRate ){
+    return juce::dsp::FilterDesign<SampleType>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
+                                                                                       sampleRate,
+                                                                                       2 * (chainSettings.lowCutSlope + 1));
+}
+template<typename SampleType = float>
+inline auto makeHighCutFilter(const ChainSettings &chainSettings, double sampleRate ){
+    return juce::dsp::FilterDesign<SampleType>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
+                                                                                       sampleRate,
+                                                                                       2 * (chainSettings.highCutSlope + 1));
+}
+
+template<typename SampleType = float>
+typename juce::dsp::IIR::Coefficients<SampleType>::Ptr makeBandFilter(const BandSettings& band, double sampleRate)
+{
+    using IIRCoefficients = juce::dsp::IIR::Coefficients<SampleType>;
+    auto freq = (SampleType) juce::jmin((double) band.freq, sampleRate * 0.49);
+    auto quality = (SampleType) band.quality;
+    auto gain = juce::Decibels::decibelsToGain((SampleType) band.gainInDecibels);
+
+    switch( band.type )
+    {
+        case BandType_LowShelf:
+            return IIRCoefficients::makeLowShelf(sampleRate, freq, quality, gain);
+        case BandType_HighShelf:
+            return IIRCoefficients::makeHighShelf(sampleRate, freq, quality, gain);
+        case BandType_Notch:
+            return IIRCoefficients::makeNotch(sampleRate, freq, quality);
+        case BandType_Tilt:
+        {
+            // a high shelf by the full gain, pulled down by half of it: -g/2 below, +g/2 above
+            auto coefficients = IIRCoefficients::makeHighShelf(sampleRate, freq, quality, gain);
+            auto trim = SampleType(1) / std::sqrt(gain);
+            auto* raw = coefficients->coefficients.getRawDataPointer();
+            for( int i = 0; i < 3; ++i )
+                raw[i] *= trim;
+            return coefficients;
+        }
+        case BandType_Peak:
+        default:
+            return IIRCoefficients::makePeakFilter(sampleRate, freq, quality, gain);
+    }
+}
+
+/*
+ The low cut, high cut and peak designs, shared by every instance in the process and by the
+ response curve. Their parameters move in steps of 1 Hz, 0.5 dB and 0.05, so there are only
+ so many designs to ask for, and automation sweeps across instances keep asking for the same
+ ones. A key is the sample rate, the kind of filter, its slope and the parameters rounded to
+ those steps; the design is made from the rounded values, so a key always has one design.
+
+ The table is NumSets sets of Ways entries each. Readers check an entry's sequence number
+ before and after copying it out and treat a change as a miss; a miss designs the filter and
+ overwrites the least recently used entry of its set, unless another thread is writing that
+ entry, in which case the design just isn't kept. Nothing blocks, so the audio thread uses it
+ directly, and memory never grows past the table.
+ */
+class CoefficientCache
+{
+public:
+    static constexpr int MaxSections = 4;
+
+    // b0, b1, b2, a1, a2 per biquad section
+    struct Design
+    {
+        int numSections { 0 };
+        std::array<std::array<double, 5>, MaxSections> sections {};
+    };
+
+    static CoefficientCache& getInstance();
+
+    Design getLowCut(const ChainSettings& chainSettings, double sampleRate);
+    Design getHighCut(const ChainSettings& chainSettings, double sampleRate);
+    Design getPeak(const ChainSettings& chainSettings, double sampleRate);
+
+    template<typename SampleType>
+    static std::array<typename juce::dsp::IIR::Coefficients<SampleType>::Ptr, MaxSections> toCoefficients(const Design& design)
+    {
+        std::array<typename juce::dsp::IIR::Coefficients<SampleType>::Ptr, MaxSections> coefficients;
+        for( int s = 0; s < design.numSections; ++s )
+        {
+            const auto& c = design.sections[s];
+            coefficients[s] = new juce::dsp::IIR::Coefficients<SampleType>((SampleType) c[0], (SampleType) c[1], (SampleType) c[2],
+                                                                          SampleType(1), (SampleType) c[3], (SampleType) c[4]);
+        }
+        return coefficients;
+    }
+private:
+    enum Kind
+    {
+        Kind_LowCut = 1,
+        Kind_HighCut,
+        Kind_PeakRBJ,
+        Kind_PeakMatched
+    };
+
+    static constexpr int NumSets = 256;
+    static constexpr int Ways = 4;
+
+    struct Entry
+    {
+        // odd while the entry is being written
+        std::atomic<juce::uint32> sequence { 0 };
+        std::atomic<juce::uint32> lastUse { 0 };
+        std::atomic<juce::uint64> sampleRate { 0 }, filter { 0 };
+        std::atomic<int> numSections { 0 };
+        std::array<std::atomic<double>, MaxSections * 5> raw;
+    };
+
+    Design get(Kind kind, int slope, float freq, float gainInDecibels, float quality, double sampleRate);
+    bool find(Entry* set, juce::uint64 sampleRate, juce::uint64 filter, Design& design);
+    void store(Entry* set, juce::uint64 sampleRate, juce::uint64 filter, const Design& design);
+
+    std::array<Entry, NumSets * Ways> entries;
+    std::atomic<juce::uint32> useCounter { 0 };
+};
 
-enum ChainPositions {
-    LowCut,
-    Peak,
-    HighCut
+/*
+ A frequency to evaluate power responses at, with what the biquad and SVF forms need of it.
+ */
+struct ResponsePoint
+{
+    double cosW, cos2W;   // of w = 2 pi f / fs
+    double prewarped;     // tan(pi f / fs)
 };
 
-using Coefficients = Filter::CoefficientsPtr;
-void updateCoefficients(Coefficients &old, const Coefficients& replacements);
+/*
+ Samples until a biquad with denominator 1 + a1 z^-1 + a2 z^-2 has rung down to 'decay'
+ times its initial level, from the radius of its slowest pole. Poles on or outside the unit
+ circle never ring out, so they get MaxTailSamples.
+ */
+constexpr int MaxTailSamples = 1 << 24;
+
+template<typename SampleType>
+int getBiquadTailSamples(SampleType a1, SampleType a2, SampleType decay)
+{
+    auto discriminant = a1 * a1 - SampleType(4) * a2;
+    auto radius = discriminant < 0 ? std::sqrt(a2)                                       // complex pair, |p|^2 = a2
+                                   : (std::abs(a1) + std::sqrt(discriminant)) / SampleType(2); // the larger real pole
 
-Coefficients makePeakFilter(const ChainSettings &chainSettings, double sampleRate);
+    if( radius <= SampleType(0) )
+        return 2;
+    if( radius >= SampleType(1) )
+        return MaxTailSamples;
 
-template<int Index, typename ChainType, typename CoefficientType>
-void update(ChainType& chain, const CoefficientType& coefficients){
-    updateCoefficients(chain.template get<Index>().coefficients, coefficients[Index]);
-    chain.template setBypassed<Index>(false);
+    auto samples = std::ceil(std::log(decay) / std::log(radius));
+    return 2 + (int) juce::jmin(samples, (SampleType) MaxTailSamples);
 }
 
-template<typename ChainType, typename CoefficientType>
-    void updateCutFilter(ChainType& chain,
-                         const CoefficientType& coefficients,
-                         const Slope &slope)
+/*
+ All biquad sections of one precision as a single cascade for both channels: the low cut
+ stages, the peak, the extra bands and the high cut stages. Each sample goes through every
+ enabled section for left and right in the same loop, so the block is read and written once
+ however many sections are on, and disabled sections cost nothing. The channels are two
+ independent lanes of the same update; a section placed on one lane only runs as a
+ pass-through on the other. Mid/side encoding and decoding are done on the way into and out
+ of that loop, so they need no passes of their own.
+ */
+template<typename SampleType>
+struct BiquadCascade
+{
+    static constexpr int Lanes = 2;
+    static constexpr int NumCutStages = 4;
+    static constexpr int LowCut = 0;
+    static constexpr int Peak = LowCut + NumCutStages;
+    static constexpr int FirstBand = Peak + 1;
+    static constexpr int HighCut = FirstBand + MaxBands;
+    static constexpr int NumSections = HighCut + NumCutStages;
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        for( auto& section : sections )
+            section = {};
+        designedBands = {};
+        bandsDesigned = false;
+        activeListDirty = true;
+        reset();
+    }
+
+    void reset()
+    {
+        for( auto& state : states )
+            state = {};
+    }
+
+    // 'raw' is b0, b1, b2, a1, a2 normalised by a0, the way IIR::Coefficients stores a biquad
+    void setSection(int index, const SampleType* raw, StereoPlacement placement)
+    {
+        for( int lane = 0; lane < Lanes; ++lane )
+            setLaneCoefficients(index, lane, raw, isOnLane(placement, lane));
+    }
+
+    // one lane of a section; a lane that is off passes its input through and ignores 'raw'
+    void setLaneCoefficients(int index, int lane, const SampleType* raw, bool on)
+    {
+        auto& section = sections[index];
+        if( on != section.on[lane] )
+        {
+            states[index].s1[lane] = 0;
+            states[index].s2[lane] = 0;
+            section.on[lane] = on;
+            activeListDirty = true;
+        }
+        section.b0[lane] = on ? raw[0] : SampleType(1);
+        section.b1[lane] = on ? raw[1] : SampleType(0);
+        section.b2[lane] = on ? raw[2] : SampleType(0);
+        section.a1[lane] = on ? raw[3] : SampleType(0);
+        section.a2[lane] = on ? raw[4] : SampleType(0);
+    }
+
+    // new coefficients for the lanes the section already runs on, keeping its state
+    void setSectionCoefficients(int index, const SampleType* raw)
     {
-        chain.template setBypassed<0>(true);
-        chain.template setBypassed<1>(true);
-        chain.template setBypassed<2>(true);
-        chain.template setBypassed<3>(true);
-        
-        switch( slope )
+        auto& section = sections[index];
+        for( int lane = 0; lane < Lanes; ++lane )
         {
-            case Slope_12:
+            if( section.on[lane] )
             {
-                update<0>(chain, coefficients);
-                break;
+                section.b0[lane] = raw[0];
+                section.b1[lane] = raw[1];
+                section.b2[lane] = raw[2];
+                section.a1[lane] = raw[3];
+                section.a2[lane] = raw[4];
+            }
+        }
+    }
+
+    void disableSection(int index)
+    {
+        auto& section = sections[index];
+        if( section.on[0] || section.on[1] )
+        {
+            section = {};
+            activeListDirty = true;
+        }
+    }
+
+    void setCutSections(int firstSection, const CoefficientCache::Design& design, bool bypassed, StereoPlacement placement)
+    {
+        for( int stage = 0; stage < NumCutStages; ++stage )
+        {
+            if( !bypassed && stage < design.numSections )
+            {
+                SampleType raw[5];
+                std::copy(design.sections[stage].begin(), design.sections[stage].end(), raw);
+                setSection(firstSection + stage, raw, placement);
             }
-            case Slope_24:
+            else
             {
-                update<1>(chain, coefficients);
-                break;
+                disableSection(firstSection + stage);
             }
-            case Slope_36:
+        }
+    }
+
+    // the band sections were overwritten from elsewhere; the next updateBands redesigns all of them
+    void invalidateBands() { bandsDesigned = false; }
+
+    // only the bands whose settings changed are redesigned
+    void updateBands(const std::array<BandSettings, MaxBands>& bands)
+    {
+        for( int b = 0; b < MaxBands; ++b )
+        {
+            const auto& band = bands[b];
+            if( bandsDesigned && band == designedBands[b] )
+                continue;
+
+            if( band.enabled )
             {
-                update<2>(chain, coefficients);
-                break;
+                auto coefficients = makeBandFilter<SampleType>(band, sampleRate);
+                jassert(coefficients->coefficients.size() == 5);
+                setSection(FirstBand + b, coefficients->coefficients.getRawDataPointer(), band.placement);
             }
-            case Slope_48:
+            else
             {
-                update<3>(chain, coefficients);
-                break;
+                disableSection(FirstBand + b);
             }
+
+            designedBands[b] = band;
         }
-}
+        bandsDesigned = true;
+    }
 
-inline auto makeLowCutFilter(const ChainSettings &chainSettings, double sampleRate ){
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
-                                                                                       sampleRate,
-                                                                                       2 * (chainSettings.lowCutSlope + 1));
-}
-inline auto makeHighCutFilter(const ChainSettings &chainSettings, double sampleRate ){
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
-                                                                                       sampleRate,
-                                                                                       2 * (chainSettings.highCutSlope + 1));
-}
+    void process(SampleType* left, SampleType* right, int numSamples, bool encodeMidSide, bool decodeMidSide)
+    {
+        if( activeListDirty )
+            rebuildActiveList();
 
-//==============================================================================
-/**
-*/
-class EqualizerAudioProcessor  : public juce::AudioProcessor
-{
-public:
-    //==============================================================================
-    EqualizerAudioProcessor();
-    ~EqualizerAudioProcessor() override;
+        auto unityGain = outputGainRamp == 0 && outputGain[0] == SampleType(1) && outputGain[1] == SampleType(1);
+        if( numActive == 0 && encodeMidSide == decodeMidSide && unityGain )
+            return;
 
-    //==============================================================================
-    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
-    void releaseResources() override;
+        for( int i = 0; i < numSamples; ++i )
+        {
+            SampleType x[Lanes] { left[i], right[i] };
 
-   #ifndef JucePlugin_PreferredChannelConfigurations
-    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
-   #endif
+            if( encodeMidSide )
+            {
+                auto mid = (x[0] + x[1]) * SampleType(0.5);
+                auto side = (x[0] - x[1]) * SampleType(0.5);
+                x[0] = mid;
+                x[1] = side;
+            }
 
-    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+            for( int n = 0; n < numActive; ++n )
+            {
+                const auto& c = sections[active[n]];
+                auto& state = states[active[n]];
 
-    //==============================================================================
-    juce::AudioProcessorEditor* createEditor() override;
-    bool hasEditor() const override;
+                for( int lane = 0; lane < Lanes; ++lane )
+                {
+                    auto y = c.b0[lane] * x[lane] + state.s1[lane];
+                    state.s1[lane] = c.b1[lane] * x[lane] - c.a1[lane] * y + state.s2[lane];
+                    state.s2[lane] = c.b2[lane] * x[lane] - c.a2[lane] * y;
+                    x[lane] = y;
+                }
+            }
 
-    //==============================================================================
-    const juce::String getName() const override;
+            if( outputGainRamp > 0 )
+            {
+                for( int lane = 0; lane < Lanes; ++lane )
+                    outputGain[lane] += outputGainStep[lane];
+                if( --outputGainRamp == 0 )
+                    std::copy(outputGainTarget, outputGainTarget + Lanes, outputGain);
+            }
 
-    bool acceptsMidi() const override;
-    bool producesMidi() const override;
-    bool isMidiEffect() const override;
-    double getTailLengthSeconds() const override;
+            x[0] *= outputGain[0];
+            x[1] *= outputGain[1];
 
-    //==============================================================================
-    int getNumPrograms() override;
-    int getCurrentProgram() override;
-    void setCurrentProgram (int index) override;
-    const juce::String getProgramName (int index) override;
-    void changeProgramName (int index, const juce::String& newName) override;
+            if( decodeMidSide )
+            {
+                left[i] = x[0] + x[1];
+                right[i] = x[0] - x[1];
+            }
+            else
+            {
+                left[i] = x[0];
+                right[i] = x[1];
+            }
+        }
+    }
 
-    //==============================================================================
-    void getStateInformation (juce::MemoryBlock& destData) override;
-    void setStateInformation (const void* data, int sizeInBytes) override;
-    
-    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
-    juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
-    using BlockType = juce::AudioBuffer<float>;
-     SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
-     SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
+    // a gain per lane applied after the last section, ramped linearly over 'rampLength' samples
+    void setOutputGain(SampleType leftOrMid, SampleType rightOrSide, int rampLength)
+    {
+        if( leftOrMid == outputGainTarget[0] && rightOrSide == outputGainTarget[1] )
+            return;
+
+        outputGainTarget[0] = leftOrMid;
+        outputGainTarget[1] = rightOrSide;
+        outputGainRamp = juce::jmax(1, rampLength);
+        for( int lane = 0; lane < Lanes; ++lane )
+            outputGainStep[lane] = (outputGainTarget[lane] - outputGain[lane]) / SampleType(outputGainRamp);
+    }
+
+    // |H|^2 of the sections running on 'lane', without the output gain
+    double getPowerResponse(int lane, const ResponsePoint& point)
+    {
+        if( activeListDirty )
+            rebuildActiveList();
+
+        double power = 1;
+        for( int n = 0; n < numActive; ++n )
+        {
+            const auto& c = sections[active[n]];
+            if( !c.on[lane] )
+                continue;
+
+            double b0 = c.b0[lane], b1 = c.b1[lane], b2 = c.b2[lane], a1 = c.a1[lane], a2 = c.a2[lane];
+            auto numerator = b0 * b0 + b1 * b1 + b2 * b2 + 2.0 * (b0 * b1 + b1 * b2) * point.cosW + 2.0 * b0 * b2 * point.cos2W;
+            auto denominator = 1.0 + a1 * a1 + a2 * a2 + 2.0 * a1 * (1.0 + a2) * point.cosW + 2.0 * a2 * point.cos2W;
+            power *= numerator / denominator;
+        }
+        return power;
+    }
+
+    int getNumActiveSections()
+    {
+        if( activeListDirty )
+            rebuildActiveList();
+        return numActive;
+    }
+
+    bool isSectionOn(int index, int lane) const { return sections[index].on[lane]; }
+
+    // b0, b1, b2, a1, a2 of one lane of a section; a pass-through if it is off on that lane
+    std::array<SampleType, 5> getSectionCoefficients(int index, int lane) const
+    {
+        const auto& c = sections[index];
+        return { c.b0[lane], c.b1[lane], c.b2[lane], c.a1[lane], c.a2[lane] };
+    }
+
+    // a conservative tail for the whole cascade: the sum of the tails of its running sections
+    int getTailSamples(SampleType decay)
+    {
+        if( activeListDirty )
+            rebuildActiveList();
+
+        int tail = 0;
+        for( int n = 0; n < numActive; ++n )
+        {
+            const auto& c = sections[active[n]];
+            int sectionTail = 0;
+            for( int lane = 0; lane < Lanes; ++lane )
+            {
+                if( c.on[lane] )
+                    sectionTail = juce::jmax(sectionTail, getBiquadTailSamples(c.a1[lane], c.a2[lane], decay));
+            }
+            tail = juce::jmin(tail + sectionTail, MaxTailSamples);
+        }
+        return tail;
+    }
+private:
+    struct Section
+    {
+        SampleType b0[Lanes] { 1, 1 }, b1[Lanes] {}, b2[Lanes] {}, a1[Lanes] {}, a2[Lanes] {};
+        bool on[Lanes] { false, false };
+    };
+
+    struct State
+    {
+        SampleType s1[Lanes] {}, s2[Lanes] {};
+    };
+
+    void rebuildActiveList()
+    {
+        numActive = 0;
+        for( int index = 0; index < NumSections; ++index )
+        {
+            if( sections[index].on[0] || sections[index].on[1] )
+                active[numActive++] = index;
+        }
+        activeListDirty = false;
+    }
+
+    std::array<Section, NumSections> sections {};
+    std::array<State, NumSections> states {};
+    std::array<BandSettings, MaxBands> designedBands {};
+    bool bandsDesigned { false };
+    std::array<int, NumSections> active {};
+    int numActive { 0 };
+    bool activeListDirty { true };
+    SampleType outputGain[Lanes] { 1, 1 }, outputGainTarget[Lanes] { 1, 1 }, outputGainStep[Lanes] {};
+    int outputGainRamp { 0 };
+    double sampleRate { 44100.0 };
+};
+
+// designs every section of 'cascade' for 'chainSettings'; all but the bands are off outside the biquad topology
+template<typename SampleType>
+void updateCascade(BiquadCascade<SampleType>& cascade, const ChainSettings& chainSettings, double sampleRate);
 
+template<typename SampleType>
+SampleType prewarp(float freq, double sampleRate)
+{
+    auto fc = juce::jmin((double) freq, sampleRate * 0.49);
+    return (SampleType) std::tan(juce::MathConstants<double>::pi * fc / sampleRate);
+}
+
+/*
+ Zavalishin's topology-preserving-transform state variable filter, in Simper's
+ trapezoidal form. The response only depends on g = tan(pi * fc / fs) and the
+ damping k, so the coefficients can be recomputed every sample for a handful of
+ multiplies and one division instead of running a new filter design.
+ */
+template<typename SampleType>
+struct TptSvf
+{
+    struct Outputs
+    {
+        SampleType bandpass, lowpass;
+    };
+
+    void reset()
+    {
+        ic1eq = 0;
+        ic2eq = 0;
+    }
+
+    Outputs tick(SampleType v0, SampleType g, SampleType k)
+    {
+        const auto a1 = SampleType(1) / (SampleType(1) + g * (g + k));
+        const auto a2 = g * a1;
+        const auto a3 = g * a2;
+
+        const auto v3 = v0 - ic2eq;
+        const auto v1 = a1 * ic1eq + a2 * v3;
+        const auto v2 = ic2eq + a2 * ic1eq + a3 * v3;
+
+        ic1eq = SampleType(2) * v1 - ic1eq;
+        ic2eq = SampleType(2) * v2 - ic2eq;
+
+        return { v1, v2 };
+    }
 private:
-    MonoChain leftChain, rightChain;
-    void updatePeakFilter(const ChainSettings& chainSettings);
-    void updateLowCutFilters(const ChainSettings &chainSettings);
-    void updateHighCutFilters(const ChainSettings &chainSettings);
-    void updateFilters();
+    SampleType ic1eq { 0 }, ic2eq { 0 };
+};
+
+/*
+ The low cut / peak / high cut chain built from TptSvf stages, for both lanes of a stereo
+ pair in one loop. Frequency, Q and gain are smoothed per sample in the g / k domain, so
+ automating them is click-free and never touches FilterDesign. The bell is the RBJ
+ (bilinear) peak; getChainSettings doesn't let 'Peak Design' ask for the matched one here.
+ */
+template<typename SampleType>
+struct SvfChain
+{
+    static constexpr int Lanes = 2;
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+        for( auto* smoothed : { &lowCutG, &highCutG, &peakG, &peakK, &peakGain } )
+            smoothed->reset(sampleRate, 0.02);
+        reset();
+        snapToTargets = true;
+    }
+
+    void reset()
+    {
+        for( int lane = 0; lane < Lanes; ++lane )
+        {
+            for( auto& stage : lowCut[lane] )
+                stage.reset();
+            for( auto& stage : highCut[lane] )
+                stage.reset();
+            peak[lane].reset();
+        }
+    }
+
+    void update(const ChainSettings& chainSettings)
+    {
+        peakQuality = chainSettings.peakQuality;
+        setTarget(lowCutG, prewarp<SampleType>(chainSettings.lowCutFreq, sampleRate));
+        setTarget(highCutG, prewarp<SampleType>(chainSettings.highCutFreq, sampleRate));
+        setTarget(peakG, prewarp<SampleType>(chainSettings.peakFreq, sampleRate));
+        setPeakGain(chainSettings.peakGainInDecibels);
+        snapToTargets = false;
+
+        updateCutStages(lowCut, lowCutDamping, numLowCutStages, chainSettings.lowCutSlope);
+        updateCutStages(highCut, highCutDamping, numHighCutStages, chainSettings.highCutSlope);
+
+        for( int lane = 0; lane < Lanes; ++lane )
+        {
+            auto lowCutNowOn = !chainSettings.lowCutBypassed && isOnLane(chainSettings.lowCutPlacement, lane);
+            auto peakNowOn = !chainSettings.peakBypassed && isOnLane(chainSettings.peakPlacement, lane);
+            auto highCutNowOn = !chainSettings.highCutBypassed && isOnLane(chainSettings.highCutPlacement, lane);
+
+            // a lane a section is switched onto starts that section from a cleared state
+            if( lowCutNowOn && !lowCutOn[lane] )
+                for( auto& stage : lowCut[lane] )
+                    stage.reset();
+            if( peakNowOn && !peakOn[lane] )
+                peak[lane].reset();
+            if( highCutNowOn && !highCutOn[lane] )
+                for( auto& stage : highCut[lane] )
+                    stage.reset();
+
+            lowCutOn[lane] = lowCutNowOn;
+            peakOn[lane] = peakNowOn;
+            highCutOn[lane] = highCutNowOn;
+        }
+    }
+
+    // retargets only the bell gain, used by the dynamic peak at control rate
+    void setPeakGain(float gainInDecibels)
+    {
+        auto gain = (SampleType) juce::Decibels::decibelsToGain(gainInDecibels);
+        setTarget(peakK, SampleType(1) / (peakQuality * std::sqrt(gain)));
+        setTarget(peakGain, gain);
+    }
+
+    /*
+     The tail at the smoothers' targets. Each stage is the bilinear transform of
+     s^2 + k s + 1 at the prewarped g, so its poles are those of
+     (1 + gk + g^2) + 2(g^2 - 1) z^-1 + (1 - gk + g^2) z^-2.
+     */
+    int getTailSamples(SampleType decay) const
+    {
+        int tail = 0;
+        auto addStage = [&tail, decay](SampleType g, SampleType k)
+        {
+            auto a0 = SampleType(1) + g * (g + k);
+            auto a1 = SampleType(2) * (g * g - SampleType(1)) / a0;
+            auto a2 = (SampleType(1) - g * k + g * g) / a0;
+            tail = juce::jmin(tail + getBiquadTailSamples(a1, a2, decay), MaxTailSamples);
+        };
+
+        if( lowCutOn[0] || lowCutOn[1] )
+            for( int s = 0; s < numLowCutStages; ++s )
+                addStage(lowCutG.getTargetValue(), lowCutDamping[s]);
+        if( peakOn[0] || peakOn[1] )
+            addStage(peakG.getTargetValue(), peakK.getTargetValue());
+        if( highCutOn[0] || highCutOn[1] )
+            for( int s = 0; s < numHighCutStages; ++s )
+                addStage(highCutG.getTargetValue(), highCutDamping[s]);
+
+        return tail;
+    }
+
+    /*
+     |H|^2 on 'lane' at the smoothers' targets. Being bilinear transforms, the stages are their
+     analog prototypes evaluated at omega = tan(pi f / fs) / g.
+     */
+    double getPowerResponse(int lane, const ResponsePoint& point) const
+    {
+        auto denominator = [](double omega, double k)
+        {
+            auto re = 1.0 - omega * omega;
+            return re * re + k * k * omega * omega;
+        };
+
+        double power = 1;
+        if( lowCutOn[lane] )
+        {
+            auto omega = point.prewarped / (double) lowCutG.getTargetValue();
+            for( int s = 0; s < numLowCutStages; ++s )
+                power *= omega * omega * omega * omega / denominator(omega, lowCutDamping[s]);
+        }
+        if( peakOn[lane] )
+        {
+            auto omega = point.prewarped / (double) peakG.getTargetValue();
+            auto k = (double) peakK.getTargetValue();
+            auto re = 1.0 - omega * omega;
+            auto boostedK = k * (double) peakGain.getTargetValue();
+            power *= (re * re + boostedK * boostedK * omega * omega) / denominator(omega, k);
+        }
+        if( highCutOn[lane] )
+        {
+            auto omega = point.prewarped / (double) highCutG.getTargetValue();
+            for( int s = 0; s < numHighCutStages; ++s )
+                power /= denominator(omega, highCutDamping[s]);
+        }
+        return power;
+    }
+
+    /*
+     The stages on 'lane' at the smoothers' targets, appended to 'dest' as the biquads they
+     run: b0, b1, b2, a1, a2 normalised by a0, the bilinear transform of each analog stage at
+     s = (1 - z^-1) / (g (1 + z^-1)).
+     */
+    template<typename Section>
+    void collectSections(int lane, std::vector<Section>& dest) const
+    {
+        auto add = [&dest](double g, double k, double n2, double n1, double n0)
+        {
+            // numerator n2 s^2 + n1 s + n0 over s^2 + k s + 1
+            auto a0 = 1.0 + g * (g + k);
+            dest.push_back({ (n2 + g * (n1 + g * n0)) / a0, 2.0 * (g * g * n0 - n2) / a0, (n2 + g * (g * n0 - n1)) / a0,
+                             2.0 * (g * g - 1.0) / a0, (1.0 + g * (g - k)) / a0 });
+        };
+
+        if( lowCutOn[lane] )
+            for( int s = 0; s < numLowCutStages; ++s )
+                add(lowCutG.getTargetValue(), lowCutDamping[s], 1, 0, 0);
+        if( peakOn[lane] )
+        {
+            auto k = (double) peakK.getTargetValue();
+            add(peakG.getTargetValue(), k, 1, k * (double) peakGain.getTargetValue(), 1);
+        }
+        if( highCutOn[lane] )
+            for( int s = 0; s < numHighCutStages; ++s )
+                add(highCutG.getTargetValue(), highCutDamping[s], 0, 0, 1);
+    }
+
+    void process(SampleType* left, SampleType* right, int numSamples, bool encodeMidSide)
+    {
+        for( int i = 0; i < numSamples; ++i )
+        {
+            SampleType x[Lanes] { left[i], right[i] };
+
+            if( encodeMidSide )
+            {
+                auto mid = (x[0] + x[1]) * SampleType(0.5);
+                auto side = (x[0] - x[1]) * SampleType(0.5);
+                x[0] = mid;
+                x[1] = side;
+            }
+
+            auto gLow = lowCutG.getNextValue();
+            auto gHigh = highCutG.getNextValue();
+            auto gPeak = peakG.getNextValue();
+            auto kPeak = peakK.getNextValue();
+            auto gain = peakGain.getNextValue();
+
+            for( int lane = 0; lane < Lanes; ++lane )
+            {
+                auto v = x[lane];
+
+                if( lowCutOn[lane] )
+                {
+                    for( int s = 0; s < numLowCutStages; ++s )
+                    {
+                        auto k = lowCutDamping[s];
+                        auto out = lowCut[lane][s].tick(v, gLow, k);
+                        v = v - k * out.bandpass - out.lowpass;
+                    }
+                }
+
+                if( peakOn[lane] )
+                {
+                    auto out = peak[lane].tick(v, gPeak, kPeak);
+                    v = v + kPeak * (gain - SampleType(1)) * out.bandpass;
+                }
+
+                if( highCutOn[lane] )
+                {
+                    for( int s = 0; s < numHighCutStages; ++s )
+                        v = highCut[lane][s].tick(v, gHigh, highCutDamping[s]).lowpass;
+                }
+
+                x[lane] = v;
+            }
+
+            left[i] = x[0];
+            right[i] = x[1];
+        }
+    }
+private:
+    static constexpr int MaxStages = 4;
+    using Stages = std::array<TptSvf<SampleType>, MaxStages>;
+    using LaneStages = std::array<Stages, Lanes>;
+    using Damping = std::array<SampleType, MaxStages>;
+
+    template<typename Smoothed>
+    void setTarget(Smoothed& smoothed, SampleType value)
+    {
+        if( snapToTargets )
+            smoothed.setCurrentAndTargetValue(value);
+        else
+            smoothed.setTargetValue(value);
+    }
+
+    /*
+     Butterworth of order 2 * numStages: each second order stage gets k = 1/Q = 2cos(theta).
+     Stages that weren't running before start from a cleared state.
+     */
+    static void updateCutStages(LaneStages& stages, Damping& damping, int& numStages, Slope slope)
+    {
+        auto newNumStages = static_cast<int>(slope) + 1;
+        auto order = 2 * newNumStages;
+
+        for( int s = 0; s < newNumStages; ++s )
+        {
+            auto theta = juce::MathConstants<double>::pi * (2 * s + 1) / (2.0 * order);
+            damping[s] = (SampleType) (2.0 * std::cos(theta));
+        }
+
+        for( auto& laneStages : stages )
+            for( int s = numStages; s < newNumStages; ++s )
+                laneStages[s].reset();
+
+        numStages = newNumStages;
+    }
+
+    LaneStages lowCut, highCut;
+    std::array<TptSvf<SampleType>, Lanes> peak;
+    Damping lowCutDamping {}, highCutDamping {};
+    int numLowCutStages { 0 }, numHighCutStages { 0 };
+    bool lowCutOn[Lanes] {}, peakOn[Lanes] {}, highCutOn[Lanes] {};
+    bool snapToTargets { true };
+    float peakQuality { 1.f };
+    double sampleRate { 44100.0 };
+
+    using Smoothed = juce::SmoothedValue<SampleType, juce::ValueSmoothingTypes::Multiplicative>;
+    Smoothed lowCutG, highCutG, peakG, peakK, peakGain;
+};
+
+/*
+ Peak coefficients designed at 1 dB steps across the 'Peak Gain' range for the current
+ frequency / Q / design. The dynamic peak interpolates between neighbouring entries at
+ control rate instead of calling makePeakFilter; the stability region of a biquad is
+ convex, so the blend of two stable neighbours is stable too.
+ */
+template<typename SampleType>
+struct PeakGainTable
+{
+    static constexpr int NumEntries = 49;
+
+    void build(const ChainSettings& chainSettings, double sampleRate)
+    {
+        if( chainSettings.peakFreq == freq && chainSettings.peakQuality == quality
+           && chainSettings.peakDesign == design && sampleRate == rate )
+            return;
+
+        freq = chainSettings.peakFreq;
+        quality = chainSettings.peakQuality;
+        design = chainSettings.peakDesign;
+        rate = sampleRate;
+
+        auto settings = chainSettings;
+        auto& cache = CoefficientCache::getInstance();
+        for( int i = 0; i < NumEntries; ++i )
+        {
+            settings.peakGainInDecibels = float(i - NumEntries / 2);
+            auto entryDesign = cache.getPeak(settings, sampleRate);
+            std::copy(entryDesign.sections[0].begin(), entryDesign.sections[0].end(), entries[i].begin());
+        }
+    }
+
+    // writes b0, b1, b2, a1, a2 for the given gain into 'dest'
+    void apply(float gainInDecibels, SampleType* dest) const
+    {
+        auto position = juce::jlimit(0.f, float(NumEntries - 1), gainInDecibels + float(NumEntries / 2));
+        auto index = juce::jmin((int) position, NumEntries - 2);
+        auto frac = (SampleType) (position - (float) index);
+        const auto& lower = entries[index];
+        const auto& upper = entries[index + 1];
+
+        for( int i = 0; i < 5; ++i )
+            dest[i] = lower[i] + frac * (upper[i] - lower[i]);
+    }
+private:
+    std::array<std::array<SampleType, 5>, NumEntries> entries {};
+    float freq { -1.f }, quality { -1.f };
+    PeakDesign design { PeakDesign::PeakDesign_RBJ };
+    double rate { 0.0 };
+};
+
+/*
+ Detector for the dynamic peak: the mid signal is band-passed around the peak frequency
+ with the peak's Q and fed through an attack/release envelope follower.
+ */
+template<typename SampleType>
+struct PeakEnvelopeFollower
+{
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+
+    void reset()
+    {
+        detector.reset();
+        envelope = 0;
+    }
+
+    void update(const ChainSettings& chainSettings)
+    {
+        g = prewarp<SampleType>(chainSettings.peakFreq, sampleRate);
+        k = SampleType(1) / chainSettings.peakQuality;
+        attackCoefficient = (SampleType) std::exp(-1.0 / (chainSettings.peakAttack * 0.001 * sampleRate));
+        releaseCoefficient = (SampleType) std::exp(-1.0 / (chainSettings.peakRelease * 0.001 * sampleRate));
+    }
+
+    // returns the detector level in decibels at the end of the block
+    SampleType process(const SampleType* left, const SampleType* right, int numSamples)
+    {
+        for( int i = 0; i < numSamples; ++i )
+        {
+            auto mid = (left[i] + right[i]) * SampleType(0.5);
+            auto level = std::abs(k * detector.tick(mid, g, k).bandpass);
+            auto coefficient = level > envelope ? attackCoefficient : releaseCoefficient;
+            envelope = level + coefficient * (envelope - level);
+        }
+
+        return juce::Decibels::gainToDecibels(envelope);
+    }
+private:
+    TptSvf<SampleType> detector;
+    SampleType envelope { 0 }, g { 0 }, k { 1 };
+    SampleType attackCoefficient { 0 }, releaseCoefficient { 0 };
+    double sampleRate { 44100.0 };
+};
+
+/*
+ 'Peak Gain' becomes the range of the dynamic peak: once the detector passes the threshold
+ the band moves towards it (boost or cut) according to the ratio.
+ */
+inline float computeDynamicPeakGain(const ChainSettings& chainSettings, float levelInDecibels)
+{
+    auto overshoot = juce::jmax(0.f, levelInDecibels - chainSettings.peakThreshold);
+    auto amount = overshoot * (1.f - 1.f / chainSettings.peakRatio);
+    auto range = chainSettings.peakGainInDecibels;
+    return range >= 0.f ? juce::jmin(amount, range) : juce::jmax(-amount, range);
+}
+
+/*
+ Everything needed to filter a stereo block in one precision: the biquad cascade and the
+ SVF chain, plus which topology and stereo mode are currently running. With the SVF topology
+ the cascade only carries the extra bands.
+
+ Switching a slope, a bypass, the topology or the stereo mode changes which sections run,
+ and the ones that come on start from cold state. Rather than switch abruptly, the filters as
+ they were are copied into a second, preallocated set that keeps running alongside the new
+ ones for CrossfadeSeconds while the output fades across; outside those transitions the
+ second set isn't touched.
+ */
+template<typename SampleType>
+struct StereoChains
+{
+    static constexpr double CrossfadeSeconds = 0.02;
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        cascade.prepare(spec.sampleRate);
+        svfChain.prepare(spec);
+        peakFollower.prepare(spec.sampleRate);
+        fadeCascade.prepare(spec.sampleRate);
+        fadeSvfChain.prepare(spec);
+        fadeLeft.resize(spec.maximumBlockSize);
+        fadeRight.resize(spec.maximumBlockSize);
+        fadeLength = juce::jmax(1, juce::roundToInt(CrossfadeSeconds * spec.sampleRate));
+        fadeRemaining = 0;
+        hasStructure = false;
+    }
+
+    void reset()
+    {
+        resetFilters();
+        fadeRemaining = 0;
+    }
+
+    // clears the running filters but lets a crossfade away from the old ones carry on
+    void resetFilters()
+    {
+        cascade.reset();
+        svfChain.reset();
+        peakFollower.reset();
+    }
+
+    // whether 'chainSettings' runs a different set of sections than the settings before it; false the first time
+    bool updateStructure(const ChainSettings& chainSettings)
+    {
+        if( hasStructure && sameStructure(structure, chainSettings) )
+            return false;
+
+        auto changed = hasStructure;
+        structure = chainSettings;
+        hasStructure = true;
+        return changed;
+    }
+
+    /*
+     Copies the running filters, state included, to the fading set. A switch during a
+     crossfade carries on from the mix as it stands rather than starting over, which would
+     step the output: less than halfway through, the output is still mostly the fading set,
+     so that keeps fading out from where it is; past halfway the running set becomes the
+     fading set and fades out from the weight it had.
+     */
+    void beginCrossfade()
+    {
+        if( fadeRemaining > 0 && fadeRemaining >= fadeLength / 2 )
+            return;
+
+        fadeCascade = cascade;
+        fadeSvfChain = svfChain;
+        fadeTopology = activeTopology;
+        fadeStereoMode = stereoMode;
+        fadeRemaining = fadeRemaining == 0 ? fadeLength : fadeLength - fadeRemaining;
+    }
+
+    // 'left' and 'right' may be the same channel; each sample is read from both before either is written
+    void process(SampleType* left, SampleType* right, int numSamples)
+    {
+        auto start = 0;
+        while( fadeRemaining > 0 && start < numSamples )
+        {
+            auto length = juce::jmin(numSamples - start, (int) fadeLeft.size());
+            if( length == 0 )
+            {
+                fadeRemaining = 0;
+                break;
+            }
+            crossfade(left + start, right + start, length);
+            start += length;
+        }
+
+        if( start < numSamples )
+            process(cascade, svfChain, activeTopology, stereoMode, left + start, right + start, numSamples - start);
+    }
+
+    void setDynamicPeakGain(float gainInDecibels)
+    {
+        if( activeTopology == Topology::Topology_SVF )
+        {
+            svfChain.setPeakGain(gainInDecibels);
+        }
+        else
+        {
+            SampleType coefficients[5];
+            peakGainTable.apply(gainInDecibels, coefficients);
+            cascade.setSectionCoefficients(BiquadCascade<SampleType>::Peak, coefficients);
+        }
+    }
+
+    double getPowerResponse(int lane, const ResponsePoint& point)
+    {
+        auto power = cascade.getPowerResponse(lane, point);
+        if( activeTopology == Topology::Topology_SVF )
+            power *= svfChain.getPowerResponse(lane, point);
+        return power;
+    }
+
+    // how long the running filters keep ringing once the input stops
+    int getTailSamples(SampleType decay)
+    {
+        auto tail = cascade.getTailSamples(decay);
+        if( activeTopology == Topology::Topology_SVF )
+            tail = juce::jmin(tail + svfChain.getTailSamples(decay), MaxTailSamples);
+        return tail;
+    }
+
+    BiquadCascade<SampleType> cascade;
+    SvfChain<SampleType> svfChain;
+    Topology activeTopology { Topology::Topology_Biquad };
+    StereoMode stereoMode { StereoMode::StereoMode_LeftRight };
+    PeakGainTable<SampleType> peakGainTable;
+    PeakEnvelopeFollower<SampleType> peakFollower;
+    // the processor's responseVersion the auto gain was last computed for
+    int autoGainVersion { -1 };
+private:
+    static void process(BiquadCascade<SampleType>& cascade, SvfChain<SampleType>& svfChain, Topology topology, StereoMode mode,
+                        SampleType* left, SampleType* right, int numSamples)
+    {
+        auto midSide = mode == StereoMode::StereoMode_MidSide;
+
+        if( topology == Topology::Topology_SVF )
+        {
+            // the SVF chain encodes on its way in, the cascade of extra bands decodes on its way out
+            svfChain.process(left, right, numSamples, midSide);
+            cascade.process(left, right, numSamples, false, midSide);
+        }
+        else
+        {
+            cascade.process(left, right, numSamples, midSide, midSide);
+        }
+    }
+
+    // at most fadeLeft.size() samples; a linear fade, as both sets filter the same input
+    void crossfade(SampleType* left, SampleType* right, int numSamples)
+    {
+        std::copy(left, left + numSamples, fadeLeft.data());
+        std::copy(right, right + numSamples, fadeRight.data());
+        process(fadeCascade, fadeSvfChain, fadeTopology, fadeStereoMode, fadeLeft.data(), fadeRight.data(), numSamples);
+        process(cascade, svfChain, activeTopology, stereoMode, left, right, numSamples);
+
+        const auto step = SampleType(1) / SampleType(fadeLength);
+        for( int i = 0; i < numSamples && fadeRemaining > 0; ++i, --fadeRemaining )
+        {
+            auto amount = SampleType(fadeLength - fadeRemaining) * step;
+            left[i] = fadeLeft[i] + amount * (left[i] - fadeLeft[i]);
+            right[i] = fadeRight[i] + amount * (right[i] - fadeRight[i]);
+        }
+    }
+
+    static bool sameStructure(const ChainSettings& a, const ChainSettings& b)
+    {
+        if( a.lowCutSlope != b.lowCutSlope || a.highCutSlope != b.highCutSlope
+           || a.lowCutBypassed != b.lowCutBypassed || a.peakBypassed != b.peakBypassed || a.highCutBypassed != b.highCutBypassed
+           || a.lowCutPlacement != b.lowCutPlacement || a.peakPlacement != b.peakPlacement || a.highCutPlacement != b.highCutPlacement
+           || a.topology != b.topology || a.stereoMode != b.stereoMode
+           || a.morph != b.morph || a.morphFrom != b.morphFrom || a.morphTo != b.morphTo )
+            return false;
+
+        for( int i = 0; i < MaxBands; ++i )
+        {
+            if( a.bands[i].enabled != b.bands[i].enabled || a.bands[i].placement != b.bands[i].placement )
+                return false;
+        }
+        return true;
+    }
+
+    BiquadCascade<SampleType> fadeCascade;
+    SvfChain<SampleType> fadeSvfChain;
+    Topology fadeTopology { Topology::Topology_Biquad };
+    StereoMode fadeStereoMode { StereoMode::StereoMode_LeftRight };
+    std::vector<SampleType> fadeLeft, fadeRight;
+    int fadeLength { 1 }, fadeRemaining { 0 };
+    ChainSettings structure;
+    bool hasStructure { false };
+};
+
+/*
+ A snapshot's biquad cascade in a form that can be blended: per section and lane, the
+ numerator as it is and the denominator as reflection coefficients, k1 = a1 / (1 + a2) and
+ k2 = a2. A biquad is stable exactly when both lie inside (-1, 1), a square, so any blend of
+ two stable sections is stable too; blending a1 and a2 directly promises no such thing. A
+ section only one side runs is blended with a pass-through, so it fades in or out.
+ */
+struct MorphEndpoint
+{
+    struct Lane
+    {
+        double b0 { 1 }, b1 { 0 }, b2 { 0 }, k1 { 0 }, k2 { 0 };
+        bool on { false };
+    };
+
+    static constexpr int NumSections = BiquadCascade<double>::NumSections;
+    std::array<std::array<Lane, BiquadCascade<double>::Lanes>, NumSections> sections;
+
+    // the cascade the processor would run for 'chainSettings' in the biquad topology
+    void design(const ChainSettings& chainSettings, double sampleRate);
+
+    template<typename SampleType>
+    static void blend(const MorphEndpoint& from, const MorphEndpoint& to, double amount, BiquadCascade<SampleType>& cascade)
+    {
+        for( int index = 0; index < NumSections; ++index )
+        {
+            for( int lane = 0; lane < BiquadCascade<SampleType>::Lanes; ++lane )
+            {
+                const auto& x = from.sections[index][lane];
+                const auto& y = to.sections[index][lane];
+                auto on = x.on || y.on;
+                auto k1 = x.k1 + amount * (y.k1 - x.k1);
+                auto k2 = x.k2 + amount * (y.k2 - x.k2);
+
+                SampleType raw[5] { SampleType(x.b0 + amount * (y.b0 - x.b0)),
+                                    SampleType(x.b1 + amount * (y.b1 - x.b1)),
+                                    SampleType(x.b2 + amount * (y.b2 - x.b2)),
+                                    SampleType(k1 * (1.0 + k2)),
+                                    SampleType(k2) };
+                cascade.setLaneCoefficients(index, lane, raw, on);
+            }
+        }
+    }
+};
+
+// one set of chains per channel pair of the bus: 1/2, 3/4, ... with a lone last channel on its own
+template<typename SampleType>
+using ChainGroups = std::vector<StereoChains<SampleType>>;
+
+/*
+ Worker threads for the channel groups of a wide bus, started and stopped outside the audio
+ callback at realtime priority where the platform allows it, else the highest there is. The
+ audio thread hands a block over with a single atomic store and takes groups itself like any
+ worker, so every group no worker has claimed by then runs inline and only the ones already
+ running elsewhere are waited for. It spins on those for SpinLimit rounds and then yields
+ between checks, so a worker preempted on the audio thread's core still gets to finish; it
+ never locks. The counter the groups are claimed from also carries their number, so a worker
+ that is late for one block can't claim a group of the next.
+
+ A worker spins for SpinMicroseconds after its last group, well short of a block period, so
+ back to back handoffs of short blocks find it awake, and then parks on its event until run()
+ wakes it for the next block. A worker still waking up when a block arrives just leaves its
+ share to the others.
+ */
+class ChannelGroupPool
+{
+public:
+    ~ChannelGroupPool() { stop(); }
+
+    void start(int numThreads)
+    {
+        stop();
+        for( int t = 0; t < numThreads; ++t )
+        {
+            workers.push_back(std::make_unique<Worker>(*this));
+            auto& worker = *workers.back();
+            if( !worker.startRealtimeThread(juce::Thread::RealtimeOptions{}) && !worker.isThreadRunning() )
+                worker.startThread(juce::Thread::Priority::highest);
+        }
+    }
+
+    void stop()
+    {
+        for( auto& worker : workers )
+        {
+            worker->signalThreadShouldExit();
+            worker->wakeUp.signal();
+        }
+        for( auto& worker : workers )
+            worker->stopThread(1000);
+        workers.clear();
+    }
+
+    int getNumThreads() const { return (int) workers.size(); }
+
+    // calls task(index) for every index below numTasks, spread over the workers and the caller
+    template<typename Task>
+    void run(int numTasks, Task& task)
+    {
+        currentTask = [](void* context, int index) { (*static_cast<Task*>(context))(index); };
+        currentContext = &task;
+        tasksDone.store(0);
+        next.store(juce::uint64(numTasks) << 32);
+
+        // a worker raises 'parked' before its last look for tasks, so none sleeps through this block
+        for( auto& worker : workers )
+            if( worker->parked.exchange(false) )
+                worker->wakeUp.signal();
+
+        runTasks();
+        for( int spins = 0; tasksDone.load() < numTasks; ++spins )
+        {
+            // a group claimed by a worker can't be taken back, only waited for
+            if( spins >= SpinLimit )
+                juce::Thread::yield();
+        }
+    }
+private:
+    static constexpr double SpinMicroseconds = 200.0;
+    static constexpr int SpinLimit = 2000;
+
+    struct Worker : juce::Thread
+    {
+        explicit Worker(ChannelGroupPool& p) : juce::Thread("Channel group worker"), pool(p) { }
+
+        void run() override
+        {
+            juce::ScopedNoDenormals noDenormals;
+            const auto spinTicks = juce::Time::secondsToHighResolutionTicks(SpinMicroseconds * 1.0e-6);
+            auto lastWork = juce::Time::getHighResolutionTicks();
+            while( !threadShouldExit() )
+            {
+                if( pool.runTasks() )
+                {
+                    lastWork = juce::Time::getHighResolutionTicks();
+                }
+                else if( juce::Time::getHighResolutionTicks() - lastWork < spinTicks )
+                {
+                    juce::Thread::yield();
+                }
+                else
+                {
+                    parked.store(true);
+                    if( !pool.hasTasks() && !threadShouldExit() )
+                        wakeUp.wait();
+                    parked.store(false);
+                    lastWork = juce::Time::getHighResolutionTicks();
+                }
+            }
+        }
+
+        ChannelGroupPool& pool;
+        juce::WaitableEvent wakeUp;
+        std::atomic<bool> parked { false };
+    };
+
+    bool hasTasks() const
+    {
+        auto current = next.load();
+        return (current & 0xffffffff) < (current >> 32);
+    }
+
+    // 'next' holds the number of tasks in its upper half and the next unclaimed index in its lower half
+    bool runTasks()
+    {
+        auto ranAny = false;
+        for( auto current = next.load(); (current & 0xffffffff) < (current >> 32); current = next.load() )
+        {
+            auto claimed = next.fetch_add(1);
+            if( (claimed & 0xffffffff) >= (claimed >> 32) )
+                break;
+
+            currentTask(currentContext, int(claimed & 0xffffffff));
+            tasksDone.fetch_add(1);
+            ranAny = true;
+        }
+        return ranAny;
+    }
+
+    void (*currentTask)(void*, int) { nullptr };
+    void* currentContext { nullptr };
+    std::atomic<juce::uint64> next { 0 };
+    std::atomic<int> tasksDone { 0 };
+    std::vector<std::unique_ptr<Worker>> workers;
+};
+
+/*
+ Peak, RMS and ITU-R BS.1770 loudness of a stereo signal, measured on the audio thread and
+ published through atomics every 100 ms, so the editor only ever reads a handful of floats.
+
+ Both channels run through the K-weighting (a high shelf and a highpass, redesigned for the
+ actual sample rate) side by side in one loop, which also accumulates the raw and weighted
+ sums of squares and the peaks. Momentary loudness is the last 400 ms, short-term the last
+ 3 s, RMS the last 300 ms.
+ */
+struct LoudnessMeter
+{
+    static constexpr float Floor = -100.f;
+
+    struct Biquad
+    {
+        double b0, b1, b2, a1, a2;
+    };
+
+    // the BS.1770 pre-filter and RLB highpass, from their analog prototypes
+    static std::array<Biquad, 2> designKWeighting(double sampleRate)
+    {
+        Biquad shelf, highpass;
+        {
+            const double f0 = 1681.974450955533, gainInDecibels = 3.999843853973347, q = 0.7071752369554196;
+            auto k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+            auto vh = std::pow(10.0, gainInDecibels / 20.0);
+            auto vb = std::pow(vh, 0.4996667741545416);
+            auto a0 = 1.0 + k / q + k * k;
+            shelf = { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                      2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+        }
+        {
+            const double f0 = 38.13547087602444, q = 0.5003270373238773;
+            auto k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+            auto a0 = 1.0 + k / q + k * k;
+            highpass = { 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+        }
+        return { shelf, highpass };
+    }
+
+    void prepare(double sampleRate)
+    {
+        auto kWeighting = designKWeighting(sampleRate);
+        shelf = kWeighting[0];
+        highpass = kWeighting[1];
+
+        subBlockLength = juce::jmax(1, juce::roundToInt(sampleRate * 0.1));
+        reset();
+    }
+
+    void reset()
+    {
+        shelfState = {};
+        highpassState = {};
+        history = {};
+        historyIndex = 0;
+        numSubBlocks = 0;
+        startSubBlock();
+
+        for( int ch = 0; ch < Lanes; ++ch )
+        {
+            peak[ch].store(Floor);
+            rms[ch].store(Floor);
+        }
+        momentary.store(Floor);
+        shortTerm.store(Floor);
+    }
+
+    template<typename SampleType>
+    void process(const SampleType* left, const SampleType* right, int numSamples)
+    {
+        for( int start = 0; start < numSamples; )
+        {
+            auto numToDo = juce::jmin(numSamples - start, subBlockLength - subBlockPosition);
+            processRun(left + start, right + start, numToDo);
+            start += numToDo;
+            subBlockPosition += numToDo;
+
+            if( subBlockPosition == subBlockLength )
+                finishSubBlock();
+        }
+    }
+
+    // all of these are in dB, or LUFS for the loudness values
+    float getPeak(int channel) const { return peak[channel].load(std::memory_order_relaxed); }
+    float getRms(int channel) const { return rms[channel].load(std::memory_order_relaxed); }
+    float getMomentaryLoudness() const { return momentary.load(std::memory_order_relaxed); }
+    float getShortTermLoudness() const { return shortTerm.load(std::memory_order_relaxed); }
+private:
+    static constexpr int Lanes = 2;
+    static constexpr int MomentarySubBlocks = 4, ShortTermSubBlocks = 30, RmsSubBlocks = 3;
+
+    struct BiquadState
+    {
+        double s1[Lanes] {}, s2[Lanes] {};
+    };
+
+    struct SubBlock
+    {
+        double weighted { 0 };
+        double raw[Lanes] {};
+    };
+
+    template<typename SampleType>
+    void processRun(const SampleType* left, const SampleType* right, int numSamples)
+    {
+        for( int i = 0; i < numSamples; ++i )
+        {
+            double x[Lanes] { (double) left[i], (double) right[i] };
+
+            for( int lane = 0; lane < Lanes; ++lane )
+            {
+                current.raw[lane] += x[lane] * x[lane];
+                currentPeak[lane] = juce::jmax(currentPeak[lane], std::abs(x[lane]));
+
+                auto y = shelf.b0 * x[lane] + shelfState.s1[lane];
+                shelfState.s1[lane] = shelf.b1 * x[lane] - shelf.a1 * y + shelfState.s2[lane];
+                shelfState.s2[lane] = shelf.b2 * x[lane] - shelf.a2 * y;
+
+                auto z = highpass.b0 * y + highpassState.s1[lane];
+                highpassState.s1[lane] = highpass.b1 * y - highpass.a1 * z + highpassState.s2[lane];
+                highpassState.s2[lane] = highpass.b2 * y - highpass.a2 * z;
+
+                // both channels have weight 1 in stereo
+                current.weighted += z * z;
+            }
+        }
+    }
+
+    void finishSubBlock()
+    {
+        history[historyIndex] = current;
+        historyIndex = (historyIndex + 1) % ShortTermSubBlocks;
+        numSubBlocks = juce::jmin(numSubBlocks + 1, ShortTermSubBlocks);
+
+        // sums over the most recent 'count' sub-blocks, fewer while the history fills up
+        auto sumOf = [this](int count, auto value)
+        {
+            double sum = 0;
+            count = juce::jmin(count, numSubBlocks);
+            for( int n = 1; n <= count; ++n )
+                sum += value(history[(historyIndex - n + ShortTermSubBlocks) % ShortTermSubBlocks]);
+            return sum / double(count * subBlockLength);
+        };
+
+        auto toLoudness = [](double meanSquare)
+        {
+            return meanSquare > 0 ? juce::jmax(Floor, float(-0.691 + 10.0 * std::log10(meanSquare))) : Floor;
+        };
+
+        auto weighted = [](const SubBlock& block) { return block.weighted; };
+        momentary.store(toLoudness(sumOf(MomentarySubBlocks, weighted)), std::memory_order_relaxed);
+        shortTerm.store(toLoudness(sumOf(ShortTermSubBlocks, weighted)), std::memory_order_relaxed);
+
+        for( int ch = 0; ch < Lanes; ++ch )
+        {
+            auto meanSquare = sumOf(RmsSubBlocks, [ch](const SubBlock& block) { return block.raw[ch]; });
+            rms[ch].store(juce::Decibels::gainToDecibels((float) std::sqrt(meanSquare), Floor), std::memory_order_relaxed);
+            peak[ch].store(juce::Decibels::gainToDecibels((float) currentPeak[ch], Floor), std::memory_order_relaxed);
+        }
+
+        startSubBlock();
+    }
+
+    void startSubBlock()
+    {
+        current = {};
+        currentPeak[0] = currentPeak[1] = 0;
+        subBlockPosition = 0;
+    }
+
+    Biquad shelf {}, highpass {};
+    BiquadState shelfState, highpassState;
+
+    int subBlockLength { 4410 }, subBlockPosition { 0 };
+    SubBlock current;
+    double currentPeak[Lanes] {};
+    std::array<SubBlock, ShortTermSubBlocks> history {};
+    int historyIndex { 0 }, numSubBlocks { 0 };
+
+    std::atomic<float> peak[Lanes] { Floor, Floor }, rms[Lanes] { Floor, Floor }, momentary { Floor }, shortTerm { Floor };
+};
+
+//==============================================================================
+/**
+*/
+class EqualizerAudioProcessor  : public juce::AudioProcessor,
+                                 juce::AudioProcessorParameter::Listener,
+                                 juce::AsyncUpdater
+{
+public:
+    //==============================================================================
+    EqualizerAudioProcessor();
+    ~EqualizerAudioProcessor() override;
+
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
+    void releaseResources() override;
+
+   #ifndef JucePlugin_PreferredChannelConfigurations
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
+   #endif
+
+    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+
+    //==============================================================================
+    juce::AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override;
+
+    //==============================================================================
+    const juce::String getName() const override;
+
+    bool acceptsMidi() const override;
+    bool producesMidi() const override;
+    bool isMidiEffect() const override;
+    double getTailLengthSeconds() const override;
+
+    //==============================================================================
+    int getNumPrograms() override;
+    int getCurrentProgram() override;
+    void setCurrentProgram (int index) override;
+    const juce::String getProgramName (int index) override;
+    void changeProgramName (int index, const juce::String& newName) override;
+
+    //==============================================================================
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+    
+    void parameterValueChanged (int parameterIndex, float newValue) override;
+    void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override { }
+    void handleAsyncUpdate() override;
+    
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
+    AnalyzerCapture analyzerCapture;
+    // driven by the 'Measurement' parameter on the audio thread, analysed by the editor
+    ResponseMeasurement measurement;
+
+    /*
+     Snapshots of every parameter, for A/B (and C/D) comparison and for morphing. Storing
+     one also designs its cascade for the morph; recalling one switches all parameters at once,
+     the way a recalled state does. They are saved with the state. Message thread only.
+     */
+    static constexpr int NumSnapshots = 4;
+    void storeSnapshot(int slot);
+    void recallSnapshot(int slot);
+    bool hasSnapshot(int slot) const { return snapshots[slot].stored; }
+
+    // measured only while an editor that shows them sets 'metersActive'
+    LoudnessMeter inputMeter, outputMeter;
+    std::atomic<bool> metersActive { false };
+
+private:
+    // float stays the default; the double chains only run when 'Processing Precision' asks
+    // for them or the host processes in double
+    ChainGroups<float> floatChains;
+    ChainGroups<double> doubleChains;
+    Precision activePrecision { Precision::Precision_Float };
+    juce::AudioBuffer<double> doublePrecisionBuffer;
+    void activatePrecision(Precision precision);
+
+    /*
+     Auto gain undoes the EQ's loudness change: the K-weighted mean of |H|^2 over log-spaced
+     points, i.e. pink noise as a loudness meter would hear it. It's recomputed only when a
+     parameter has changed since, which bumps responseVersion, and ramped in over
+     AutoGainRampSeconds at the cascade's output. While morphing it is worked out from the
+     blend instead, whenever the blend has moved.
+     */
+    static constexpr int NumAutoGainPoints = 64;
+    static constexpr double AutoGainRampSeconds = 0.05;
+    std::vector<ResponsePoint> autoGainPoints;
+    std::vector<double> autoGainWeights;
+    std::atomic<int> responseVersion { 0 };
+    void prepareAutoGain(double sampleRate);
+    template<typename SampleType>
+    void updateAutoGain(StereoChains<SampleType>& chains, const ChainSettings& chainSettings);
+    // anything with getPowerResponse(lane, point)
+    template<typename Response>
+    double getAutoGain(Response& response, int lane) const;
+    template<typename SampleType>
+    static void measure(LoudnessMeter& meter, const juce::AudioBuffer<SampleType>& buffer);
+
+    /*
+     Silent input, blocks of exact zeros, is skipped once the filters have rung out, their tail
+     being measured down to TailDecay. The tail is only measured again when the filters have
+     changed, which is when responseVersion moves on from tailVersion, a recall or snapshot
+     lands, or a morph is gliding. The analyzer keeps being fed for AnalyzerSilenceSamples
+     more, the longest FFT, so it settles on the floor.
+     */
+    static constexpr double TailDecay = 1.0e-6;
+    static constexpr int AnalyzerSilenceSamples = 8192;
+    juce::int64 silentSamples { 0 };
+    int tailSamples { 0 };
+    // the responseVersion the block's settings were read at, and the one the tail was measured for
+    int blockVersion { 0 };
+    int tailVersion { -1 };
+    bool filtersAsleep { false };
+    std::atomic<double> tailLengthSeconds { 0.0 };
+    template<typename SampleType, typename BufferSampleType>
+    bool skipSilentBlock(ChainGroups<SampleType>& groups, const juce::AudioBuffer<BufferSampleType>& buffer);
+    template<typename SampleType>
+    void updateTailLength(StereoChains<SampleType>& chains);
+    bool analyzerIsIdle() const { return silentSamples >= tailSamples + AnalyzerSilenceSamples; }
+
+    // the dynamic peak is re-tuned every ControlBlockSize samples
+    static constexpr size_t ControlBlockSize = 32;
+    template<typename SampleType>
+    void processChains(ChainGroups<SampleType>& groups, juce::AudioBuffer<SampleType>& buffer, const ChainSettings& chainSettings);
+    template<typename SampleType>
+    void processGroup(StereoChains<SampleType>& chains, SampleType* left, SampleType* right, int numSamples, const ChainSettings& chainSettings);
+
+    /*
+     Wide buses are processed a channel pair at a time. With 'Parallel Channels' on, the pairs
+     of a block are shared out over groupPool, unless the block is shorter than
+     MinParallelSamples and wouldn't pay for the handoff. The pool only has workers while the
+     processor is prepared, the parameter is on and there is more than one pair; the parameter
+     changing starts or stops them from the message thread, under the callback lock.
+     */
+    static constexpr int MaxChannels = 16;
+    static constexpr int MinParallelSamples = 64;
+    ChannelGroupPool groupPool;
+    int parallelChannelsIndex { -1 };
+    bool groupsPrepared { false };
+    void updateGroupPool();
+    template<typename SampleType>
+    void updateFilters(StereoChains<SampleType>& chains, const ChainSettings &chainSettings);
+    template<typename SampleType>
+    void updateFilters(ChainGroups<SampleType>& groups, const ChainSettings &chainSettings);
+    void updateFilters();
+
+    /*
+     Recalling a state writes the parameters one at a time on the message thread, so a block
+     reading them meanwhile would run half of the old preset and half of the new. While a
+     recall is pending the audio thread keeps using blockSettings, the settings of its last
+     block; setStateInformation then hands over the complete new settings through
+     recalledSettings, with their designs already in the coefficient cache. The audio thread
+     is the only one that ever touches the filters.
+     */
+    std::atomic<int> pendingRecalls { 0 };
+    Fifo<ChainSettings> recalledSettings;
+    ChainSettings blockSettings;
+    ChainSettings getBlockSettings();
+    // checks blockSettings after every block
+    friend class StateRecallTests;
+
+    /*
+     The saved state is a binary block: StateMagic, StateVersion and the number of parameters,
+     then each parameter's ID as a null-terminated UTF-8 string followed by its normalised
+     value as a float, and an FNV-1a checksum of all of it, little-endian throughout. It is
+     restored by ID through one replaceState, so a state saved before a parameter was added
+     loads with that parameter at its default, and IDs this build doesn't know are ignored. A
+     later format gets a new StateVersion, and restoreBinaryState reads the older ones into
+     the same IDs. 'Measurement' is never saved and is switched off whenever a state is
+     loaded; states saved as the APVTS ValueTree still load, without snapshots. The stored
+     snapshots follow the parameters, before the checksum, see writeSnapshots.
+     */
+    void handOverRecall();
+    static constexpr juce::uint32 StateMagic = 0x54534245;
+    static constexpr int StateVersion = 1;
+    static juce::String getParameterID(const juce::AudioProcessorParameter* param);
+    bool restoreBinaryState(const void* data, int sizeInBytes);
+    bool restoreValueTreeState(const void* data, int sizeInBytes);
+    struct StateEntry
+    {
+        juce::String id;
+        float value;
+    };
+    static std::vector<StateEntry> readEntries(juce::InputStream& in);
+    std::vector<float> matchEntries(const std::vector<StateEntry>& entries);
+    void writeSnapshots(juce::OutputStream& out) const;
+
+    /*
+     With 'Morph' on, the cascade runs a blend of the designs of snapshots 'Morph From' and
+     'Morph To' instead of the parameters' own: always the biquad topology, without the
+     dynamic peak. The designs are made when a snapshot is stored and reach the audio thread
+     through morphUpdates; each block only blends them, at ControlBlockSize steps along the
+     smoothed 'Morph Amount'. Until both slots hold a snapshot, as storedSnapshots tells the
+     audio thread, 'Morph' has no effect.
+     */
+    struct Snapshot
+    {
+        bool stored { false };
+        std::vector<float> values;
+        ChainSettings chainSettings;
+    };
+    struct MorphUpdate
+    {
+        int slot { 0 };
+        MorphEndpoint endpoint;
+    };
+    static constexpr double MorphSmoothingSeconds = 0.05;
+    std::array<Snapshot, NumSnapshots> snapshots;
+    Fifo<MorphUpdate> morphUpdates;
+    std::array<MorphEndpoint, NumSnapshots> morphEndpoints;
+    juce::SmoothedValue<double> morphPosition;
+    double morphBlockStart { 0 }, morphBlockEnd { 0 };
+    // the auto gain of the blend at morphAutoGainAmount between the slots in morphAutoGainSlots
+    BiquadCascade<double> morphGainCascade;
+    double morphAutoGains[2] { 1, 1 };
+    double morphAutoGainAmount { -1 };
+    int morphAutoGainSlots { -1 };
+    // a bit per stored slot
+    std::atomic<int> storedSnapshots { 0 };
+    void publishSnapshot(int slot);
+    void publishSnapshots();
+    ChainSettings getSnapshotSettings(const std::vector<float>& values);
+    static bool belongsToSnapshot(const juce::String& id);
+    ChainSettings withMorph(ChainSettings chainSettings);
+    ChainSettings withMeasurement(ChainSettings chainSettings);
+    void updateMorph(const ChainSettings& chainSettings, int numSamples);
     juce::dsp::Oscillator<float> osc;
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EqualizerAudioProcessor)
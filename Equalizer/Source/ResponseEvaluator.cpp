@@ -0,0 +1,135 @@
+/*
+  ==============================================================================
+
+    ResponseEvaluator.cpp
+
+  ==============================================================================
+*/
+
+#include "ResponseEvaluator.h"
+
+void ResponseEvaluator::setFrequencies(const double* frequencies, int newNumFrequencies, double newSampleRate)
+{
+    numFrequencies = newNumFrequencies;
+    sampleRate = newSampleRate;
+
+    auto numRegisters = (size_t) (numFrequencies + Width - 1) / Width;
+    cosW.resize(numRegisters);
+    sinW.resize(numRegisters);
+    cos2W.resize(numRegisters);
+    sin2W.resize(numRegisters);
+
+    alignas(Vec::SIMDRegisterSize) double c[Width], s[Width], c2[Width], s2[Width];
+    for( size_t r = 0; r < numRegisters; ++r )
+    {
+        for( int i = 0; i < Width; ++i )
+        {
+            auto index = (int) r * Width + i;
+            auto w = index < numFrequencies ? juce::MathConstants<double>::twoPi * frequencies[index] / sampleRate : 0.0;
+            c[i] = std::cos(w);
+            s[i] = std::sin(w);
+            c2[i] = std::cos(2.0 * w);
+            s2[i] = std::sin(2.0 * w);
+        }
+        cosW[r] = Vec::fromRawArray(c);
+        sinW[r] = Vec::fromRawArray(s);
+        cos2W[r] = Vec::fromRawArray(c2);
+        sin2W[r] = Vec::fromRawArray(s2);
+    }
+}
+
+/*
+ With e^-jw = cos w - j sin w, a polynomial c0 + c1 z^-1 + c2 z^-2 on the unit circle is
+     C = (c0 + c1 cos w + c2 cos 2w) - j (c1 sin w + c2 sin 2w)
+ and its group delay is Re(K / C) with K = sum k c_k z^-k. Across the cascade the powers
+ multiply, the group delays add, and the phase is the angle of the product of every N conj(D).
+ */
+void ResponseEvaluator::evaluate(const Section* sections, int numSections,
+                                 double* magnitudeDb, double* phase, double* groupDelay) const
+{
+    const auto one = Vec::expand(1.0);
+    const auto two = Vec::expand(2.0);
+    // keeps the group delay finite at a zero exactly on the unit circle
+    const auto tiny = Vec::expand(1.0e-300);
+
+    alignas(Vec::SIMDRegisterSize) double numeratorOut[Width], denominatorOut[Width], realOut[Width], imagOut[Width], delayOut[Width];
+
+    for( size_t r = 0; r < cosW.size(); ++r )
+    {
+        const auto c1 = cosW[r], s1 = sinW[r], c2 = cos2W[r], s2 = sin2W[r];
+
+        auto numeratorPower = one, denominatorPower = one;
+        auto productReal = one, productImag = Vec::expand(0.0);
+        auto delay = Vec::expand(0.0);
+
+        for( int n = 0; n < numSections; ++n )
+        {
+            const auto& section = sections[n];
+            const auto b0 = Vec::expand(section.b0), b1 = Vec::expand(section.b1), b2 = Vec::expand(section.b2);
+            const auto a1 = Vec::expand(section.a1), a2 = Vec::expand(section.a2);
+
+            auto nReal = b0 + b1 * c1 + b2 * c2;
+            auto nImag = Vec::expand(0.0) - (b1 * s1 + b2 * s2);
+            auto dReal = one + a1 * c1 + a2 * c2;
+            auto dImag = Vec::expand(0.0) - (a1 * s1 + a2 * s2);
+
+            auto nPower = nReal * nReal + nImag * nImag;
+            auto dPower = dReal * dReal + dImag * dImag;
+            numeratorPower = numeratorPower * nPower;
+            denominatorPower = denominatorPower * dPower;
+
+            if( phase != nullptr )
+            {
+                // N conj(D), then into the running product
+                auto real = nReal * dReal + nImag * dImag;
+                auto imag = nImag * dReal - nReal * dImag;
+                auto nextReal = productReal * real - productImag * imag;
+                productImag = productReal * imag + productImag * real;
+                productReal = nextReal;
+            }
+
+            if( groupDelay != nullptr )
+            {
+                auto nkReal = b1 * c1 + two * b2 * c2;
+                auto nkImag = Vec::expand(0.0) - (b1 * s1 + two * b2 * s2);
+                auto dkReal = a1 * c1 + two * a2 * c2;
+                auto dkImag = Vec::expand(0.0) - (a1 * s1 + two * a2 * s2);
+
+                alignas(Vec::SIMDRegisterSize) double nk[Width], np[Width], dk[Width], dp[Width];
+                (nkReal * nReal + nkImag * nImag).copyToRawArray(nk);
+                Vec::max(nPower, tiny).copyToRawArray(np);
+                (dkReal * dReal + dkImag * dImag).copyToRawArray(dk);
+                Vec::max(dPower, tiny).copyToRawArray(dp);
+
+                // SIMDRegister has no division
+                alignas(Vec::SIMDRegisterSize) double sectionDelay[Width];
+                for( int i = 0; i < Width; ++i )
+                    sectionDelay[i] = nk[i] / np[i] - dk[i] / dp[i];
+                delay = delay + Vec::fromRawArray(sectionDelay);
+            }
+        }
+
+        numeratorPower.copyToRawArray(numeratorOut);
+        denominatorPower.copyToRawArray(denominatorOut);
+        productReal.copyToRawArray(realOut);
+        productImag.copyToRawArray(imagOut);
+        delay.copyToRawArray(delayOut);
+
+        for( int i = 0; i < Width; ++i )
+        {
+            auto index = (int) r * Width + i;
+            if( index >= numFrequencies )
+                break;
+
+            if( magnitudeDb != nullptr )
+            {
+                auto power = numeratorOut[i] / denominatorOut[i];
+                magnitudeDb[index] = power > 1.0e-10 ? 10.0 * std::log10(power) : -100.0;
+            }
+            if( phase != nullptr )
+                phase[index] = std::atan2(imagOut[i], realOut[i]);
+            if( groupDelay != nullptr )
+                groupDelay[index] = delayOut[i];
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/*
+  ==============================================================================
+
+    ResponseEvaluator.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include "PluginProcessor.h"
+
+/*
+ The frequency response of a cascade of biquads at a whole array of frequencies at once, for
+ the response curve and for offline tools. The trigonometry of every frequency is worked out
+ once, when the frequencies are set, and stored structure-of-arrays a SIMD register at a time;
+ evaluating a cascade then runs each section across a register of frequencies in one go.
+
+ Each section's numerator and denominator are evaluated on the unit circle as complex numbers,
+ the way IIR::Coefficients::getMagnitudeForFrequency does. Phase and group delay come out of
+ the same pass, so asking for them costs no second evaluation.
+
+ The maths is double precision: near 20 Hz a low cut's denominator is a few parts per million
+ of its terms, which floats can't resolve to a hundredth of a dB.
+ */
+class ResponseEvaluator
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<double>;
+
+    // b0, b1, b2, a1, a2 normalised by a0
+    struct Section
+    {
+        double b0 { 1 }, b1 { 0 }, b2 { 0 }, a1 { 0 }, a2 { 0 };
+    };
+
+    void setFrequencies(const double* frequencies, int numFrequencies, double sampleRate);
+    int getNumFrequencies() const { return numFrequencies; }
+    double getSampleRate() const { return sampleRate; }
+
+    /*
+     The response of 'sections' in series at every frequency: the magnitude in dB (floored at
+     -100 dB, like Decibels::gainToDecibels), the phase in radians wrapped to (-pi, pi] and the
+     group delay in samples. Any of the outputs may be nullptr; the others hold
+     getNumFrequencies() values each.
+     */
+    void evaluate(const Section* sections, int numSections,
+                  double* magnitudeDb, double* phase, double* groupDelay) const;
+
+    // the sections the cascade runs on 'lane', in processing order
+    template<typename SampleType>
+    static void collectSections(const BiquadCascade<SampleType>& cascade, int lane, std::vector<Section>& dest)
+    {
+        dest.clear();
+        for( int index = 0; index < BiquadCascade<SampleType>::NumSections; ++index )
+        {
+            if( !cascade.isSectionOn(index, lane) )
+                continue;
+
+            auto c = cascade.getSectionCoefficients(index, lane);
+            dest.push_back({ (double) c[0], (double) c[1], (double) c[2], (double) c[3], (double) c[4] });
+        }
+    }
+private:
+    static constexpr int Width = (int) Vec::SIMDNumElements;
+
+    int numFrequencies { 0 };
+    double sampleRate { 0 };
+    // of w = 2 pi f / fs, one register per Width frequencies; the last one is padded with w = 0
+    std::vector<Vec> cosW, sinW, cos2W, sin2W;
+};
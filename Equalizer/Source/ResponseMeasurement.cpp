@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+
+    ResponseMeasurement.cpp
+
+  ==============================================================================
+*/
+
+#include "ResponseMeasurement.h"
+
+// taps 32, 22, 2 and 1 of a Galois LFSR: a maximal-length sequence
+static constexpr juce::uint32 MlsTaps = 0x80200003u;
+
+void ResponseMeasurement::prepare(double newSampleRate)
+{
+    state = State_Idle;
+    sampleRate = newSampleRate;
+
+    // about a second and a half at any sample rate
+    order = (int) std::ceil(std::log2(sampleRate));
+    length = 1 << order;
+    sweepEnd = juce::jmin(24000.0, 0.49 * sampleRate);
+
+    excitation.assign(length, 0.f);
+    recording.assign(length, 0.f);
+    blockStart = -1;
+
+    fft = std::make_unique<juce::dsp::FFT>(order);
+    timeData.assign(length, {});
+    excitationSpectrum.assign(length, {});
+    responseSpectrum.assign(length, {});
+    binMagnitudeDb.assign(length / 2 + 1, -100.f);
+    impulseResponse.assign(length, 0.f);
+    resultIsValid = false;
+}
+
+template<typename SampleType>
+void ResponseMeasurement::writeExcitation(juce::AudioBuffer<SampleType>& buffer, MeasurementSignal signal, juce::dsp::Oscillator<float>& osc)
+{
+    blockStart = -1;
+    if( length == 0 )
+        return;
+
+    auto current = state.load();
+    if( signal == MeasurementSignal_Off )
+    {
+        // abandon a recording half way; a finished one still belongs to the message thread
+        if( current == State_Running )
+            state = State_Idle;
+        return;
+    }
+
+    if( current == State_Idle || (current == State_Running && signal != runningSignal) )
+    {
+        runningSignal = signal;
+        position = 0;
+        totalLength = signal == MeasurementSignal_Mls ? 2 * length : length;
+        recordStart = totalLength - length;
+        osc.reset();
+        state = State_Running;
+        current = State_Running;
+    }
+
+    if( current != State_Running )
+        return;
+
+    blockStart = position;
+    const auto numSamples = buffer.getNumSamples();
+    auto* first = buffer.getWritePointer(0);
+    for( int i = 0; i < numSamples; ++i )
+    {
+        auto p = position + i;
+        auto value = p < totalLength ? nextExcitationSample(osc, p) : 0.f;
+        if( p >= recordStart && p < totalLength )
+            excitation[p - recordStart] = value;
+        first[i] = (SampleType) value;
+    }
+
+    // every channel gets the same signal, so with mid/side the side is silent and left is mid
+    for( int ch = 1; ch < buffer.getNumChannels(); ++ch )
+        buffer.copyFrom(ch, 0, buffer, 0, 0, numSamples);
+}
+
+template<typename SampleType>
+void ResponseMeasurement::captureResponse(const juce::AudioBuffer<SampleType>& buffer)
+{
+    if( blockStart < 0 )
+        return;
+
+    const auto numSamples = buffer.getNumSamples();
+    auto* output = buffer.getReadPointer(0);
+    for( int i = 0; i < numSamples; ++i )
+    {
+        auto p = blockStart + i;
+        if( p >= recordStart && p < totalLength )
+            recording[p - recordStart] = (float) output[i];
+    }
+
+    position = blockStart + numSamples;
+    blockStart = -1;
+    if( position >= totalLength )
+        state = State_Recorded;
+}
+
+template void ResponseMeasurement::writeExcitation<float>(juce::AudioBuffer<float>&, MeasurementSignal, juce::dsp::Oscillator<float>&);
+template void ResponseMeasurement::writeExcitation<double>(juce::AudioBuffer<double>&, MeasurementSignal, juce::dsp::Oscillator<float>&);
+template void ResponseMeasurement::captureResponse<float>(const juce::AudioBuffer<float>&);
+template void ResponseMeasurement::captureResponse<double>(const juce::AudioBuffer<double>&);
+
+float ResponseMeasurement::nextExcitationSample(juce::dsp::Oscillator<float>& osc, int p)
+{
+    if( runningSignal == MeasurementSignal_Mls )
+    {
+        // the same N samples every period
+        if( p % length == 0 )
+            lfsr = 1;
+        auto bit = lfsr & 1u;
+        lfsr = (lfsr >> 1) ^ (bit != 0 ? MlsTaps : 0u);
+        return bit != 0 ? Level : -Level;
+    }
+
+    // the oscillator follows the exponential sweep's instantaneous frequency sample by sample
+    const auto sweepLength = 3 * length / 4;
+    if( p >= sweepLength )
+        return 0.f;
+
+    auto t = double(p) / double(sweepLength);
+    osc.setFrequency((float) (SweepStart * std::exp(t * std::log(sweepEnd / SweepStart))), true);
+    auto value = osc.processSample(0.f);
+
+    // short fades, so neither end clicks
+    auto fadePosition = juce::jmin(p, sweepLength - 1 - p);
+    if( fadePosition < FadeLength )
+        value *= 0.5f * (1.f - std::cos(juce::MathConstants<float>::pi * float(fadePosition) / float(FadeLength)));
+
+    return Level * value;
+}
+
+bool ResponseMeasurement::analyse()
+{
+    if( state.load() != State_Recorded )
+        return false;
+
+    for( int n = 0; n < length; ++n )
+        timeData[n] = { excitation[n], 0.f };
+    fft->perform(timeData.data(), excitationSpectrum.data(), false);
+
+    for( int n = 0; n < length; ++n )
+        timeData[n] = { recording[n], 0.f };
+    fft->perform(timeData.data(), responseSpectrum.data(), false);
+
+    // regularised where the excitation has (next to) no energy, e.g. above the end of the sweep
+    float maxPower = 0.f;
+    for( const auto& x : excitationSpectrum )
+        maxPower = juce::jmax(maxPower, std::norm(x));
+    const auto regularisation = 1.0e-8f * maxPower;
+
+    for( int k = 0; k < length; ++k )
+    {
+        const auto& x = excitationSpectrum[k];
+        responseSpectrum[k] = responseSpectrum[k] * std::conj(x) / (std::norm(x) + regularisation);
+    }
+
+    for( int k = 0; k <= length / 2; ++k )
+        binMagnitudeDb[k] = juce::Decibels::gainToDecibels(std::abs(responseSpectrum[k]));
+
+    fft->perform(responseSpectrum.data(), timeData.data(), true);
+    for( int n = 0; n < length; ++n )
+        impulseResponse[n] = timeData[n].real();
+
+    resultSampleRate = sampleRate;
+    resultIsValid = true;
+    state = State_Idle;
+    return true;
+}
+
+void ResponseMeasurement::getMagnitudeDb(const double* frequencies, int numFrequencies, double* dest) const
+{
+    const auto lastBin = length / 2;
+    for( int i = 0; i < numFrequencies; ++i )
+    {
+        if( !resultIsValid )
+        {
+            dest[i] = -100.0;
+            continue;
+        }
+
+        auto position = juce::jlimit(0.0, double(lastBin - 1), frequencies[i] * double(length) / resultSampleRate);
+        auto bin = (int) position;
+        auto frac = position - double(bin);
+        dest[i] = binMagnitudeDb[bin] + frac * (binMagnitudeDb[bin + 1] - binMagnitudeDb[bin]);
+    }
+}
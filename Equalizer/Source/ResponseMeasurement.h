@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    ResponseMeasurement.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+enum MeasurementSignal
+{
+    MeasurementSignal_Off,
+    MeasurementSignal_Sweep,
+    MeasurementSignal_Mls
+};
+
+/*
+ Measures the processor's own response: while a signal is selected, the audio thread replaces
+ the input of every channel with an excitation, records what the chain makes of it on the
+ first output channel, and the message thread deconvolves the recording into an impulse and a
+ frequency response. The result is left/mid's response as it actually runs, so it can be laid
+ over the designed curve to check one against the other.
+
+ A recording is N = 2^k samples, about a second and a half, and the deconvolution is a
+ circular one at that length: Y X* / (|X|^2 + e), regularised where the excitation has no
+ energy. Both signals are N-periodic as far as the recording can tell:
+   - the sweep is exponential, 10 Hz to just below Nyquist, over the first 3/4 of the
+     recording; the last quarter is silence that takes the chain's ringing, so the
+     circular convolution is the linear one.
+   - the MLS comes from a maximal-length LFSR, restarted every N samples, so it is played
+     twice and only the second period, with the chain in its steady state, is recorded.
+
+ The recording is handed over through 'state': the audio thread owns it from Idle to
+ Recorded, the message thread from Recorded until it sets Idle again. The excitation is what
+ the output carries while measuring, at -12 dBFS; between a finished recording and its
+ analysis the input passes through as usual. The processor holds the auto gain, the dynamic
+ peak and morphing off while a signal is selected, so what is measured is the static design
+ the editor draws.
+ */
+class ResponseMeasurement
+{
+public:
+    // message thread, while no audio is being processed
+    void prepare(double sampleRate);
+
+    // audio thread, around the processing of each block
+    template<typename SampleType>
+    void writeExcitation(juce::AudioBuffer<SampleType>& buffer, MeasurementSignal signal, juce::dsp::Oscillator<float>& osc);
+    template<typename SampleType>
+    void captureResponse(const juce::AudioBuffer<SampleType>& buffer);
+
+    /*
+     Message thread: deconvolves a finished recording, keeps the result and lets the audio
+     thread start the next one. Returns true if there is a new result.
+     */
+    bool analyse();
+    bool hasResult() const { return resultIsValid; }
+    // the measured magnitude at each frequency, in dB floored at -100 dB
+    void getMagnitudeDb(const double* frequencies, int numFrequencies, double* dest) const;
+    const std::vector<float>& getImpulseResponse() const { return impulseResponse; }
+private:
+    enum State
+    {
+        State_Idle,
+        State_Running,
+        State_Recorded
+    };
+    std::atomic<int> state { State_Idle };
+
+    static constexpr float Level = 0.25f;
+    static constexpr double SweepStart = 10.0;
+    static constexpr int FadeLength = 256;
+
+    float nextExcitationSample(juce::dsp::Oscillator<float>& osc, int p);
+
+    double sampleRate { 0 };
+    int order { 0 };
+    int length { 0 };
+
+    // the audio thread's side
+    MeasurementSignal runningSignal { MeasurementSignal_Off };
+    int position { 0 }, totalLength { 0 }, recordStart { 0 };
+    int blockStart { -1 };
+    double sweepEnd { 0 };
+    juce::uint32 lfsr { 1 };
+    std::vector<float> excitation, recording;
+
+    // the message thread's side
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<std::complex<float>> timeData, excitationSpectrum, responseSpectrum;
+    std::vector<float> binMagnitudeDb, impulseResponse;
+    double resultSampleRate { 0 };
+    bool resultIsValid { false };
+};
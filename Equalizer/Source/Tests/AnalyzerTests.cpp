@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    AnalyzerTests.cpp
+
+  ==============================================================================
+*/
+
+#include "../PluginEditor.h"
+
+#if JUCE_UNIT_TESTS
+
+/*
+ The multi-resolution analyzer: a low sine has to come out at the resolution of its deepest
+ level, and a frame, pushing an editor tick's worth of samples and producing the traces, is
+ timed against the single 8192-point transform it stands in for.
+ */
+class AnalyzerTests : public juce::UnitTest
+{
+public:
+    AnalyzerTests() : juce::UnitTest("Analyzer", "Equalizer") { }
+
+    void runTest() override
+    {
+        beginTest("A low sine peaks within a bin of the deepest level");
+        checkLowSine();
+
+        beginTest("Benchmark: multi-resolution frame against an 8192-point FFT");
+        auto multiResolution = timeMultiResolution();
+        auto single = timeSingleFFT();
+        logMessage("per frame, multi-resolution: " + juce::String(multiResolution * 1.0e6, 1) + " us, 8192-point: "
+                   + juce::String(single * 1.0e6, 1) + " us, ratio " + juce::String(multiResolution / single, 2));
+        expectGreaterThan(multiResolution, 0.0);
+        expectGreaterThan(single, 0.0);
+    }
+private:
+    static constexpr double SampleRate = 48000.0;
+    // what the editor's 60 Hz timer finds new at 48 kHz
+    static constexpr int FrameSamples = 800;
+    static constexpr int NumFrames = 2000;
+
+    using Generator = MultiResolutionFFTDataGenerator<std::vector<float>>;
+
+    void checkLowSine()
+    {
+        constexpr double Frequency = 40.0;
+        Generator generator;
+        generator.prepare(FFTOrder::order2048, SampleRate);
+
+        // enough for the deepest level to have a full transform's worth
+        const auto numSamples = 8 * generator.getFFTSize() + FrameSamples;
+        std::vector<float> sine((size_t) numSamples);
+        for( int i = 0; i < numSamples; ++i )
+            sine[(size_t) i] = 0.5f * (float) std::sin(juce::MathConstants<double>::twoPi * Frequency * i / SampleRate);
+        generator.push(sine.data(), sine.data(), numSamples);
+        generator.produceFFTDataForRendering(AnalyzerDisplay_LeftRight, -120.f);
+
+        std::vector<float> data;
+        expect(generator.getFFTData(data));
+        const auto& frequencies = generator.getFrequencies();
+        auto peak = std::max_element(data.begin(), data.end()) - data.begin();
+        auto binWidth = SampleRate / double(1 << (Generator::NumLevels - 1)) / double(generator.getFFTSize());
+        expectWithinAbsoluteError((double) frequencies[(size_t) peak], Frequency, binWidth);
+    }
+
+    static std::vector<float> makeNoise(int numSamples)
+    {
+        juce::Random random(1);
+        std::vector<float> noise((size_t) numSamples);
+        for( auto& sample : noise )
+            sample = random.nextFloat() - 0.5f;
+        return noise;
+    }
+
+    // seconds per frame
+    static double timeMultiResolution()
+    {
+        Generator generator;
+        generator.prepare(FFTOrder::order2048, SampleRate);
+        auto left = makeNoise(FrameSamples), right = makeNoise(FrameSamples);
+
+        auto start = juce::Time::getHighResolutionTicks();
+        for( int frame = 0; frame < NumFrames; ++frame )
+        {
+            generator.push(left.data(), right.data(), FrameSamples);
+            generator.produceFFTDataForRendering(AnalyzerDisplay_LeftRight, -48.f);
+        }
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) / NumFrames;
+    }
+
+    // the transform and the decibels of every bin, which is what one 8192-point frame cost
+    static double timeSingleFFT()
+    {
+        StereoFFT transform;
+        transform.changeOrder(FFTOrder::order8192);
+        const auto fftSize = transform.getFFTSize();
+        auto left = makeNoise(fftSize), right = makeNoise(fftSize);
+        std::vector<float> first((size_t) fftSize / 2), second((size_t) fftSize / 2);
+
+        auto start = juce::Time::getHighResolutionTicks();
+        for( int frame = 0; frame < NumFrames; ++frame )
+        {
+            transform.produceMagnitudes(left.data(), right.data(), AnalyzerDisplay_LeftRight, first.data(), second.data());
+            for( size_t bin = 0; bin < first.size(); ++bin )
+            {
+                first[bin] = juce::Decibels::gainToDecibels(first[bin], -48.f);
+                second[bin] = juce::Decibels::gainToDecibels(second[bin], -48.f);
+            }
+        }
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) / NumFrames;
+    }
+};
+
+static AnalyzerTests analyzerTests;
+
+#endif
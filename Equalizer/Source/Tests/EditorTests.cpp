@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    EditorTests.cpp
+
+  ==============================================================================
+*/
+
+#include "../PluginEditor.h"
+
+#if JUCE_UNIT_TESTS
+
+#include <numeric>
+
+/*
+ Opens NumEditors editors one after another on the same prepared processor, the way a host
+ does when a session's plugin windows are opened in turn, and times the constructor and the
+ first paint apart. The first editor builds the shared look and feel and grid labels; the
+ others should only pay for themselves.
+ */
+class EditorTests : public juce::UnitTest
+{
+public:
+    EditorTests() : juce::UnitTest("Editor", "Equalizer") { }
+
+    void runTest() override
+    {
+        beginTest("Benchmark: opening an editor");
+
+        EqualizerAudioProcessor processor;
+        processor.setRateAndBufferSizeDetails(SampleRate, BlockSize);
+        processor.prepareToPlay(SampleRate, BlockSize);
+
+        double constructSeconds[NumEditors], paintSeconds[NumEditors];
+        for( int e = 0; e < NumEditors; ++e )
+        {
+            auto start = juce::Time::getHighResolutionTicks();
+            std::unique_ptr<juce::AudioProcessorEditor> editor(processor.createEditor());
+            auto constructed = juce::Time::getHighResolutionTicks();
+
+            juce::Image image(juce::Image::ARGB, editor->getWidth(), editor->getHeight(), true);
+            juce::Graphics g(image);
+            editor->paintEntireComponent(g, false);
+            auto painted = juce::Time::getHighResolutionTicks();
+
+            constructSeconds[e] = juce::Time::highResolutionTicksToSeconds(constructed - start);
+            paintSeconds[e] = juce::Time::highResolutionTicksToSeconds(painted - constructed);
+            expect(editor->getWidth() > 0 && editor->getHeight() > 0);
+        }
+
+        auto meanOfRest = [](const double* seconds)
+        {
+            return std::accumulate(seconds + 1, seconds + NumEditors, 0.0) / (NumEditors - 1);
+        };
+        logMessage("first editor: " + describe(constructSeconds[0], paintSeconds[0])
+                   + "; the next " + juce::String(NumEditors - 1) + " on average: "
+                   + describe(meanOfRest(constructSeconds), meanOfRest(paintSeconds)));
+
+        processor.releaseResources();
+    }
+private:
+    static constexpr double SampleRate = 48000.0;
+    static constexpr int BlockSize = 512;
+    static constexpr int NumEditors = 50;
+
+    static juce::String describe(double constructSeconds, double paintSeconds)
+    {
+        return "constructed in " + juce::String(constructSeconds * 1000.0, 2) + " ms, first paint "
+               + juce::String(paintSeconds * 1000.0, 2) + " ms";
+    }
+};
+
+static EditorTests editorTests;
+
+#endif
@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    FilterTopologyTests.cpp
+
+  ==============================================================================
+*/
+
+#include "../PluginProcessor.h"
+#include "../ResponseEvaluator.h"
+
+#if JUCE_UNIT_TESTS
+
+/*
+ The SVF topology against the biquad one. The response curve draws the SVF from the sections
+ SvfChain::collectSections gives it, so those are held against the chain's own power response,
+ and its bell against the biquad cascade's RBJ peak. The benchmark then runs the same settings
+ through the processor in either topology and logs what each costs.
+ */
+class FilterTopologyTests : public juce::UnitTest
+{
+public:
+    FilterTopologyTests() : juce::UnitTest("Filter topology", "Equalizer") { }
+
+    void runTest() override
+    {
+        auto& random = getRandom();
+
+        beginTest("The drawn SVF sections match the SVF chain");
+        for( int trial = 0; trial < NumTrials; ++trial )
+            checkSvfSections(makeRandomSettings(random));
+
+        beginTest("The SVF bell is the biquad's RBJ peak");
+        for( int trial = 0; trial < NumTrials; ++trial )
+        {
+            auto settings = makeRandomSettings(random);
+            settings.lowCutBypassed = true;
+            settings.highCutBypassed = true;
+            checkPeak(settings);
+        }
+
+        beginTest("Benchmark: SVF against the biquad cascade");
+        auto biquadSeconds = benchmark(Topology::Topology_Biquad);
+        auto svfSeconds = benchmark(Topology::Topology_SVF);
+        logMessage("biquad: " + describe(biquadSeconds) + ", SVF: " + describe(svfSeconds)
+                   + ", SVF / biquad " + juce::String(svfSeconds / biquadSeconds, 2));
+        expectGreaterThan(biquadSeconds, 0.0);
+        expectGreaterThan(svfSeconds, 0.0);
+    }
+private:
+    static constexpr double SampleRate = 48000.0;
+    static constexpr int BlockSize = 256;
+    static constexpr int NumTrials = 50;
+    static constexpr int NumFrequencies = 200;
+    static constexpr double ToleranceDb = 0.01;
+    static constexpr double BenchmarkSeconds = 20.0;
+
+    static ChainSettings makeRandomSettings(juce::Random& random)
+    {
+        ChainSettings settings;
+        settings.lowCutFreq = juce::mapToLog10(random.nextFloat(), 20.f, 500.f);
+        settings.highCutFreq = juce::mapToLog10(random.nextFloat(), 2000.f, 20000.f);
+        settings.peakFreq = juce::mapToLog10(random.nextFloat(), 20.f, 20000.f);
+        settings.peakGainInDecibels = -24.f + 48.f * random.nextFloat();
+        settings.peakQuality = 0.1f + 9.9f * random.nextFloat();
+        settings.lowCutSlope = static_cast<Slope>(random.nextInt(4));
+        settings.highCutSlope = static_cast<Slope>(random.nextInt(4));
+        return settings;
+    }
+
+    static double toDecibels(double power)
+    {
+        return 10.0 * std::log10(juce::jmax(power, 1.0e-100));
+    }
+
+    static std::vector<ResponsePoint> makePoints(std::vector<double>& frequencies)
+    {
+        std::vector<ResponsePoint> points;
+        for( int i = 0; i < NumFrequencies; ++i )
+        {
+            auto frequency = juce::mapToLog10(double(i) / double(NumFrequencies - 1), 20.0, 20000.0);
+            auto w = juce::MathConstants<double>::twoPi * frequency / SampleRate;
+            frequencies.push_back(frequency);
+            points.push_back({ std::cos(w), std::cos(2.0 * w), std::tan(0.5 * w) });
+        }
+        return points;
+    }
+
+    void checkSvfSections(const ChainSettings& settings)
+    {
+        SvfChain<double> svfChain;
+        svfChain.prepare({ SampleRate, (juce::uint32) BlockSize, 1 });
+        svfChain.update(settings);
+
+        std::vector<double> frequencies;
+        auto points = makePoints(frequencies);
+        ResponseEvaluator evaluator;
+        evaluator.setFrequencies(frequencies.data(), NumFrequencies, SampleRate);
+
+        std::vector<ResponseEvaluator::Section> sections;
+        svfChain.collectSections(0, sections);
+        std::vector<double> magnitudeDb(NumFrequencies);
+        evaluator.evaluate(sections.data(), (int) sections.size(), magnitudeDb.data(), nullptr, nullptr);
+
+        for( int i = 0; i < NumFrequencies; ++i )
+        {
+            auto expectedDb = toDecibels(svfChain.getPowerResponse(0, points[(size_t) i]));
+            // below the evaluator's floor there is nothing to compare
+            if( expectedDb > -90.0 )
+                expectWithinAbsoluteError(magnitudeDb[(size_t) i], expectedDb, ToleranceDb,
+                                          "at " + juce::String(frequencies[(size_t) i], 1) + " Hz");
+        }
+    }
+
+    void checkPeak(ChainSettings settings)
+    {
+        settings.peakDesign = PeakDesign::PeakDesign_RBJ;
+
+        SvfChain<double> svfChain;
+        svfChain.prepare({ SampleRate, (juce::uint32) BlockSize, 1 });
+        svfChain.update(settings);
+
+        settings.topology = Topology::Topology_Biquad;
+        BiquadCascade<double> cascade;
+        cascade.prepare(SampleRate);
+        updateCascade(cascade, settings, SampleRate);
+
+        std::vector<double> frequencies;
+        auto points = makePoints(frequencies);
+        for( int i = 0; i < NumFrequencies; ++i )
+        {
+            const auto& point = points[(size_t) i];
+            expectWithinAbsoluteError(toDecibels(svfChain.getPowerResponse(0, point)),
+                                      toDecibels(cascade.getPowerResponse(0, point)), ToleranceDb,
+                                      "at " + juce::String(frequencies[(size_t) i], 1) + " Hz");
+        }
+    }
+
+    // seconds of processing per BenchmarkSeconds of stereo noise, both cuts and the peak on
+    static double benchmark(Topology topology)
+    {
+        EqualizerAudioProcessor processor;
+        auto set = [&processor](const juce::String& id, float value)
+        {
+            auto* param = processor.apvts.getParameter(id);
+            param->setValueNotifyingHost(param->convertTo0to1(value));
+        };
+        set("Filter Topology", (float) topology);
+        set("LowCut Freq", 80.f);
+        set("LowCut Slope", (float) Slope::Slope_48);
+        set("HighCut Freq", 12000.f);
+        set("HighCut Slope", (float) Slope::Slope_48);
+        set("Peak Gain", 6.f);
+        processor.setRateAndBufferSizeDetails(SampleRate, BlockSize);
+        processor.prepareToPlay(SampleRate, BlockSize);
+
+        juce::AudioBuffer<float> buffer(2, BlockSize);
+        juce::MidiBuffer midiMessages;
+        juce::Random random(1);
+        const auto numBlocks = juce::roundToInt(BenchmarkSeconds * SampleRate) / BlockSize;
+        juce::int64 ticks = 0;
+        for( int block = 0; block < numBlocks; ++block )
+        {
+            for( int ch = 0; ch < buffer.getNumChannels(); ++ch )
+                for( int i = 0; i < BlockSize; ++i )
+                    buffer.setSample(ch, i, 0.1f * (random.nextFloat() - 0.5f));
+
+            auto start = juce::Time::getHighResolutionTicks();
+            processor.processBlock(buffer, midiMessages);
+            ticks += juce::Time::getHighResolutionTicks() - start;
+        }
+
+        processor.releaseResources();
+        return juce::Time::highResolutionTicksToSeconds(ticks);
+    }
+
+    static juce::String describe(double seconds)
+    {
+        return juce::String(seconds * 1000.0, 1) + " ms (" + juce::String(BenchmarkSeconds / seconds, 0) + "x realtime)";
+    }
+};
+
+static FilterTopologyTests filterTopologyTests;
+
+#endif
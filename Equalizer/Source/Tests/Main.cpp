@@ -0,0 +1,36 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    The console runner of EqualizerTests.jucer, which builds the plugin's sources
+    with JUCE_UNIT_TESTS. Runs every test in the "Equalizer" category, or only
+    those whose names contain the first argument, and exits non-zero if any failed.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+int main (int argc, char* argv[])
+{
+    // the processor's parameters and the editor both want a message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::String filter = argc > 1 ? juce::String(argv[1]) : juce::String();
+    juce::Array<juce::UnitTest*> tests;
+    for( auto* test : juce::UnitTest::getTestsInCategory("Equalizer") )
+    {
+        if( filter.isEmpty() || test->getName().containsIgnoreCase(filter) )
+            tests.add(test);
+    }
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+    runner.runTests(tests);
+
+    auto failures = 0;
+    for( int i = 0; i < runner.getNumResults(); ++i )
+        failures += runner.getResult(i)->failures;
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+    ResponseEvaluatorTests.cpp
+
+  ==============================================================================
+*/
+
+#include "../ResponseEvaluator.h"
+
+#if JUCE_UNIT_TESTS
+
+/*
+ Random cascades of peaks, high passes and low passes, evaluated at once and checked section
+ by section against IIR::Coefficients. The group delay has no reference there, so it is held
+ against the numerical derivative of the evaluator's own phase, taken a small step either
+ side of every frequency.
+ */
+class ResponseEvaluatorTests : public juce::UnitTest
+{
+public:
+    ResponseEvaluatorTests() : juce::UnitTest("ResponseEvaluator", "Equalizer") { }
+
+    void runTest() override
+    {
+        auto& random = getRandom();
+
+        beginTest("Magnitude and phase match IIR::Coefficients");
+        for( int trial = 0; trial < NumTrials; ++trial )
+        {
+            auto sampleRate = trial % 2 == 0 ? 44100.0 : 96000.0;
+            auto cascade = makeRandomCascade(random, sampleRate, 1 + trial % 8);
+            checkMagnitudeAndPhase(cascade, sampleRate);
+        }
+
+        beginTest("Group delay matches the derivative of the phase");
+        for( int trial = 0; trial < NumTrials; ++trial )
+        {
+            auto sampleRate = trial % 2 == 0 ? 44100.0 : 96000.0;
+            auto cascade = makeRandomCascade(random, sampleRate, 1 + trial % 8);
+            checkGroupDelay(cascade, sampleRate);
+        }
+    }
+private:
+    static constexpr int NumTrials = 50;
+    static constexpr int NumFrequencies = 300;
+    static constexpr double MagnitudeToleranceDb = 0.01;
+    static constexpr double PhaseTolerance = 1.0e-6;
+    // relative to the delay, or absolute in samples below one sample
+    static constexpr double GroupDelayTolerance = 1.0e-3;
+    // the derivative's step either side, relative to the frequency
+    static constexpr double DerivativeStep = 1.0e-5;
+
+    using Coefficients = juce::dsp::IIR::Coefficients<double>;
+
+    static std::vector<Coefficients::Ptr> makeRandomCascade(juce::Random& random, double sampleRate, int numSections)
+    {
+        std::vector<Coefficients::Ptr> cascade;
+        for( int s = 0; s < numSections; ++s )
+        {
+            auto frequency = juce::mapToLog10((double) random.nextFloat(), 20.0, 20000.0);
+            auto quality = 0.3 + 9.7 * random.nextDouble();
+            auto gain = juce::Decibels::decibelsToGain(-24.0 + 48.0 * random.nextDouble());
+            switch( random.nextInt(3) )
+            {
+                case 0: cascade.push_back(Coefficients::makePeakFilter(sampleRate, frequency, quality, gain)); break;
+                case 1: cascade.push_back(Coefficients::makeHighPass(sampleRate, frequency, quality)); break;
+                default: cascade.push_back(Coefficients::makeLowPass(sampleRate, frequency, quality)); break;
+            }
+        }
+        return cascade;
+    }
+
+    static std::vector<ResponseEvaluator::Section> toSections(const std::vector<Coefficients::Ptr>& cascade)
+    {
+        std::vector<ResponseEvaluator::Section> sections;
+        for( auto& coefficients : cascade )
+        {
+            auto* c = coefficients->getRawCoefficients();
+            sections.push_back({ c[0], c[1], c[2], c[3], c[4] });
+        }
+        return sections;
+    }
+
+    static std::vector<double> makeFrequencies(double scale)
+    {
+        std::vector<double> frequencies(NumFrequencies);
+        for( int i = 0; i < NumFrequencies; ++i )
+            frequencies[(size_t) i] = scale * juce::mapToLog10(double(i) / double(NumFrequencies - 1), 20.0, 20000.0);
+        return frequencies;
+    }
+
+    void checkMagnitudeAndPhase(const std::vector<Coefficients::Ptr>& cascade, double sampleRate)
+    {
+        auto frequencies = makeFrequencies(1.0);
+        auto sections = toSections(cascade);
+
+        ResponseEvaluator evaluator;
+        evaluator.setFrequencies(frequencies.data(), NumFrequencies, sampleRate);
+        std::vector<double> magnitudeDb(NumFrequencies), phase(NumFrequencies);
+        evaluator.evaluate(sections.data(), (int) sections.size(), magnitudeDb.data(), phase.data(), nullptr);
+
+        for( int i = 0; i < NumFrequencies; ++i )
+        {
+            auto frequency = frequencies[(size_t) i];
+            auto expectedDb = 0.0, expectedPhase = 0.0;
+            for( auto& coefficients : cascade )
+            {
+                expectedDb += juce::Decibels::gainToDecibels(coefficients->getMagnitudeForFrequency(frequency, sampleRate), -1000.0);
+                expectedPhase += coefficients->getPhaseForFrequency(frequency, sampleRate);
+            }
+
+            // below the evaluator's floor there is nothing to compare
+            if( expectedDb > -90.0 )
+                expectWithinAbsoluteError(magnitudeDb[(size_t) i], expectedDb, MagnitudeToleranceDb,
+                                          "magnitude at " + juce::String(frequency, 1) + " Hz");
+
+            // near a zero the phase turns too fast to pin down
+            if( expectedDb > -60.0 )
+                expectWithinAbsoluteError(std::remainder(phase[(size_t) i] - expectedPhase, juce::MathConstants<double>::twoPi), 0.0, PhaseTolerance,
+                                          "phase at " + juce::String(frequency, 1) + " Hz");
+        }
+    }
+
+    void checkGroupDelay(const std::vector<Coefficients::Ptr>& cascade, double sampleRate)
+    {
+        auto frequencies = makeFrequencies(1.0);
+        auto below = makeFrequencies(1.0 - DerivativeStep);
+        auto above = makeFrequencies(1.0 + DerivativeStep);
+        auto sections = toSections(cascade);
+
+        ResponseEvaluator evaluator, belowEvaluator, aboveEvaluator;
+        evaluator.setFrequencies(frequencies.data(), NumFrequencies, sampleRate);
+        belowEvaluator.setFrequencies(below.data(), NumFrequencies, sampleRate);
+        aboveEvaluator.setFrequencies(above.data(), NumFrequencies, sampleRate);
+
+        std::vector<double> magnitudeDb(NumFrequencies), groupDelay(NumFrequencies), belowPhase(NumFrequencies), abovePhase(NumFrequencies);
+        evaluator.evaluate(sections.data(), (int) sections.size(), magnitudeDb.data(), nullptr, groupDelay.data());
+        belowEvaluator.evaluate(sections.data(), (int) sections.size(), nullptr, belowPhase.data(), nullptr);
+        aboveEvaluator.evaluate(sections.data(), (int) sections.size(), nullptr, abovePhase.data(), nullptr);
+
+        for( int i = 0; i < NumFrequencies; ++i )
+        {
+            if( magnitudeDb[(size_t) i] <= -60.0 )
+                continue;
+
+            auto step = juce::MathConstants<double>::twoPi * (above[(size_t) i] - below[(size_t) i]) / sampleRate;
+            auto expected = -std::remainder(abovePhase[(size_t) i] - belowPhase[(size_t) i], juce::MathConstants<double>::twoPi) / step;
+            expectWithinAbsoluteError(groupDelay[(size_t) i], expected, GroupDelayTolerance * juce::jmax(1.0, std::abs(expected)),
+                                      "group delay at " + juce::String(frequencies[(size_t) i], 1) + " Hz");
+        }
+    }
+};
+
+static ResponseEvaluatorTests responseEvaluatorTests;
+
+#endif
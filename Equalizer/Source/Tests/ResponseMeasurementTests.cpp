@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    ResponseMeasurementTests.cpp
+
+  ==============================================================================
+*/
+
+#include "../ResponseMeasurement.h"
+
+#if JUCE_UNIT_TESTS
+
+/*
+ Runs each excitation through a known cascade, block by block the way processBlock does, and
+ checks the deconvolved magnitude against the cascade's own, wherever the cascade passes
+ something.
+ */
+class ResponseMeasurementTests : public juce::UnitTest
+{
+public:
+    ResponseMeasurementTests() : juce::UnitTest("ResponseMeasurement", "Equalizer") { }
+
+    void runTest() override
+    {
+        beginTest("Sweep recovers a known cascade");
+        measureCascade(MeasurementSignal_Sweep);
+
+        beginTest("MLS recovers a known cascade");
+        measureCascade(MeasurementSignal_Mls);
+    }
+private:
+    static constexpr double SampleRate = 48000.0;
+    static constexpr int BlockSize = 512;
+    static constexpr double ToleranceDb = 0.05;
+
+    using Coefficients = juce::dsp::IIR::Coefficients<float>;
+
+    void measureCascade(MeasurementSignal signal)
+    {
+        std::vector<Coefficients::Ptr> cascade
+        {
+            Coefficients::makeHighPass(SampleRate, 100.f),
+            Coefficients::makeHighPass(SampleRate, 100.f),
+            Coefficients::makePeakFilter(SampleRate, 1000.f, 1.f, juce::Decibels::decibelsToGain(6.f)),
+            Coefficients::makePeakFilter(SampleRate, 5000.f, 4.f, juce::Decibels::decibelsToGain(-9.f))
+        };
+        std::vector<juce::dsp::IIR::Filter<float>> filters;
+        filters.reserve(cascade.size());
+        for( auto& coefficients : cascade )
+            filters.emplace_back(coefficients);
+
+        juce::dsp::Oscillator<float> osc;
+        osc.initialise([](float x) { return std::sin(x); });
+        osc.prepare({ SampleRate, (juce::uint32) BlockSize, 1 });
+
+        ResponseMeasurement measurement;
+        measurement.prepare(SampleRate);
+
+        // the MLS plays two recordings' worth, each about a second and a half
+        const auto maxBlocks = juce::roundToInt(4.0 * SampleRate) / BlockSize;
+        juce::AudioBuffer<float> buffer(2, BlockSize);
+        auto analysed = false;
+        for( int block = 0; block < maxBlocks && !analysed; ++block )
+        {
+            buffer.clear();
+            measurement.writeExcitation(buffer, signal, osc);
+
+            auto* samples = buffer.getWritePointer(0);
+            for( int i = 0; i < BlockSize; ++i )
+                for( auto& filter : filters )
+                    samples[i] = filter.processSample(samples[i]);
+
+            measurement.captureResponse(buffer);
+            analysed = measurement.analyse();
+        }
+        expect(analysed, "no recording was finished");
+        expect(measurement.hasResult());
+
+        constexpr int NumFrequencies = 200;
+        std::vector<double> frequencies(NumFrequencies), measured(NumFrequencies);
+        for( int i = 0; i < NumFrequencies; ++i )
+            frequencies[(size_t) i] = juce::mapToLog10(double(i) / double(NumFrequencies - 1), 20.0, 20000.0);
+        measurement.getMagnitudeDb(frequencies.data(), NumFrequencies, measured.data());
+
+        for( int i = 0; i < NumFrequencies; ++i )
+        {
+            auto designed = 0.0;
+            for( auto& coefficients : cascade )
+                designed += juce::Decibels::gainToDecibels(coefficients->getMagnitudeForFrequency(frequencies[(size_t) i], SampleRate));
+
+            // deep in the cut the measurement is noise
+            if( designed > -40.0 )
+                expectWithinAbsoluteError(measured[(size_t) i], designed, ToleranceDb,
+                                          "at " + juce::String(frequencies[(size_t) i], 1) + " Hz");
+        }
+    }
+};
+
+static ResponseMeasurementTests responseMeasurementTests;
+
+#endif
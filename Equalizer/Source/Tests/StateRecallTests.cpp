@@ -0,0 +1,172 @@
+/*
+  ==============================================================================
+
+    StateRecallTests.cpp
+
+  ==============================================================================
+*/
+
+#include "../PluginProcessor.h"
+
+#if JUCE_UNIT_TESTS
+
+#include <thread>
+
+/*
+ Loads two states in turn, as fast as this thread can, while another thread runs blocks
+ through the processor the way a host's audio callback would. The states differ in every
+ frequency and gain, from the first parameter to the last band, so a block reading the
+ parameters halfway through a recall would run settings that are neither.
+
+ The benchmark loads a session of NumInstances prepared instances, once from the binary
+ block and once from the APVTS ValueTree the states used to be.
+ */
+class StateRecallTests : public juce::UnitTest
+{
+public:
+    StateRecallTests() : juce::UnitTest("State recall", "Equalizer") { }
+
+    void runTest() override
+    {
+        beginTest("A block never mixes two recalled states");
+
+        EqualizerAudioProcessor processor;
+        processor.setRateAndBufferSizeDetails(SampleRate, BlockSize);
+
+        juce::MemoryBlock states[2];
+        ChainSettings settings[2];
+        for( int s = 0; s < 2; ++s )
+        {
+            setParameters(processor, s);
+            settings[s] = getChainSettings(processor.apvts);
+            processor.getStateInformation(states[s]);
+        }
+
+        // after the states are set up, so the first block already runs one of them
+        processor.prepareToPlay(SampleRate, BlockSize);
+
+        std::atomic<bool> loading { true };
+        int numBlocks = 0, numMixed = 0;
+        std::thread audioThread([&]
+        {
+            juce::AudioBuffer<float> buffer(2, BlockSize);
+            juce::MidiBuffer midiMessages;
+            juce::Random random;
+            while( loading.load() )
+            {
+                // noise, so the processor never sleeps on silence
+                for( int ch = 0; ch < buffer.getNumChannels(); ++ch )
+                    for( int i = 0; i < BlockSize; ++i )
+                        buffer.setSample(ch, i, 0.1f * (random.nextFloat() - 0.5f));
+
+                processor.processBlock(buffer, midiMessages);
+
+                // blockSettings is what the block just ran, and only this thread touches it
+                const auto& used = processor.blockSettings;
+                if( !sameSettings(used, settings[0]) && !sameSettings(used, settings[1]) )
+                    ++numMixed;
+                ++numBlocks;
+            }
+        });
+
+        for( int load = 0; load < NumLoads; ++load )
+        {
+            const auto& state = states[load % 2];
+            processor.setStateInformation(state.getData(), (int) state.getSize());
+        }
+        loading = false;
+        audioThread.join();
+
+        logMessage(juce::String(NumLoads) + " loads against " + juce::String(numBlocks) + " blocks");
+        expectGreaterThan(numBlocks, 0);
+        expectEquals(numMixed, 0, "blocks that ran a mix of both states");
+
+        processor.releaseResources();
+
+        beginTest("Benchmark: loading a session of " + juce::String(NumInstances) + " instances");
+        benchmarkSession();
+    }
+private:
+    static constexpr double SampleRate = 48000.0;
+    static constexpr int BlockSize = 64;
+    static constexpr int NumLoads = 20000;
+    static constexpr int NumInstances = 500;
+
+    void benchmarkSession()
+    {
+        EqualizerAudioProcessor source;
+        setParameters(source, 0);
+        source.storeSnapshot(0);
+        setParameters(source, 1);
+        source.storeSnapshot(1);
+
+        juce::MemoryBlock binaryState, treeState;
+        source.getStateInformation(binaryState);
+        {
+            juce::MemoryOutputStream mos(treeState, false);
+            source.apvts.copyState().writeToStream(mos);
+        }
+
+        std::vector<std::unique_ptr<EqualizerAudioProcessor>> session;
+        for( int i = 0; i < NumInstances; ++i )
+        {
+            session.push_back(std::make_unique<EqualizerAudioProcessor>());
+            session.back()->setRateAndBufferSizeDetails(SampleRate, BlockSize);
+            session.back()->prepareToPlay(SampleRate, BlockSize);
+        }
+
+        auto load = [&session](const juce::MemoryBlock& state)
+        {
+            auto start = juce::Time::getHighResolutionTicks();
+            for( auto& processor : session )
+                processor->setStateInformation(state.getData(), (int) state.getSize());
+            return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        };
+        auto binarySeconds = load(binaryState);
+        expect(sameSettings(getChainSettings(session.front()->apvts), getChainSettings(source.apvts)));
+        expect(session.front()->hasSnapshot(1), "the binary block brings the snapshots");
+        auto treeSeconds = load(treeState);
+        expect(!session.front()->hasSnapshot(1), "a ValueTree state has no snapshots");
+
+        logMessage("binary block (" + juce::String((int) binaryState.getSize()) + " bytes): " + juce::String(binarySeconds * 1000.0, 1)
+                   + " ms, ValueTree (" + juce::String((int) treeState.getSize()) + " bytes): " + juce::String(treeSeconds * 1000.0, 1) + " ms");
+
+        for( auto& processor : session )
+            processor->releaseResources();
+    }
+
+    static void setParameters(EqualizerAudioProcessor& processor, int which)
+    {
+        auto set = [&processor](const juce::String& id, float value)
+        {
+            auto* param = processor.apvts.getParameter(id);
+            param->setValueNotifyingHost(param->convertTo0to1(value));
+        };
+
+        auto scale = which == 0 ? 1.f : 2.f;
+        auto gain = which == 0 ? 6.f : -6.f;
+        set("LowCut Freq", 30.f * scale);
+        set("HighCut Freq", 8000.f * scale);
+        set("Peak Freq", 500.f * scale);
+        set("Peak Gain", gain);
+        set("Peak Quality", 0.7f * scale);
+        for( int b = 0; b < MaxBands; ++b )
+        {
+            auto prefix = "Band " + juce::String(b + 1) + " ";
+            set(prefix + "Enabled", 1.f);
+            set(prefix + "Freq", 100.f * float(b + 1) * scale);
+            set(prefix + "Gain", gain);
+        }
+    }
+
+    static bool sameSettings(const ChainSettings& a, const ChainSettings& b)
+    {
+        return a.lowCutFreq == b.lowCutFreq && a.highCutFreq == b.highCutFreq
+            && a.peakFreq == b.peakFreq && a.peakGainInDecibels == b.peakGainInDecibels && a.peakQuality == b.peakQuality
+            && a.bands == b.bands;
+    }
+};
+
+static StateRecallTests stateRecallTests;
+
+#endif